@@ -0,0 +1,300 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+// Сравнение способов формирования и разбора json на телеметрии и командах разного размера.
+// Сборка и запуск (из корня репозитория):
+// g++ -std=c++17 -O2 -I include -I <rapidjson>/include bench/json_bench.cpp -o json_bench
+// ./json_bench [result.csv]
+//
+// small  -   1 модуль (~0.2 КБ),
+// medium -  10 модулей (~2 КБ),
+// large  - 100 модулей (~20 КБ),
+// huge   - 1000 модулей (~200 КБ),
+// max    - 5000 модулей (~1 МБ), секций больше размера кэша путей app::Json (4096).
+
+#define APP_BENCH_ALLOC
+
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "app/bench.h"
+#include "app/cbor.h"
+#include "app/json.h"
+#include "app/json_writer.h"
+#include "app/simple_json.h"
+
+
+namespace
+{
+	// Данные одного модуля.
+	struct module_struct
+	{
+		std::string section; // "/mN"
+		std::string name;    // "mN"
+		double lat;
+		double lon;
+		double alt;
+		double speed;
+		int32_t count;
+		uint32_t ms;
+		bool ok;
+		std::string status;
+		std::array<double, 3> vel;
+	};
+
+	struct size_struct
+	{
+		const char* name;
+		size_t modules;
+		size_t iter;
+	};
+
+	std::vector<module_struct> make_data(size_t n)
+	{
+		std::vector<module_struct> data(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			module_struct& m = data[i];
+			m.name = "m" + std::to_string(i);
+			m.section = "/" + m.name;
+			m.lat = 55.751244123 + i * 1e-4;
+			m.lon = 37.618423456 - i * 1e-4;
+			m.alt = 156.2734 + i;
+			m.speed = 12.3456789 * (i % 7);
+			m.count = static_cast<int32_t>(i * 1000 - 500);
+			m.ms = static_cast<uint32_t>(i * 12345);
+			m.ok = (i % 2) == 0;
+			m.status = (i % 3) ? "run" : "wait \"gps\"";
+			m.vel = {0.123456 * i, -1.5, 3.14159265};
+		}
+		return data;
+	}
+
+	// Запись телеметрии (app::Json, app::JsonWriter, app::Cbor).
+	template <typename TWriter>
+	void fill(TWriter& w, const std::vector<module_struct>& data, bool round)
+	{
+		for (const auto& m : data)
+		{
+			w.set(m.section.c_str());
+			if (round)
+			{
+				w.set("lat", m.lat, 7);
+				w.set("lon", m.lon, 7);
+				w.set("alt", m.alt, 2);
+				w.set("speed", m.speed, 2);
+				w.set("vel", m.vel, 3);
+			}
+			else
+			{
+				w.set("lat", m.lat);
+				w.set("lon", m.lon);
+				w.set("alt", m.alt);
+				w.set("speed", m.speed);
+				w.set("vel", m.vel);
+			}
+			w.set("count", m.count);
+			w.set("ms", m.ms);
+			w.set("ok", m.ok);
+			w.set("status", m.status);
+		}
+	}
+
+	// Запись телеметрии (app::SimpleJson).
+	void fill(app::SimpleJson& w, const std::vector<module_struct>& data, bool round)
+	{
+		const int p = round ? 7 : -1;
+		const int p2 = round ? 2 : -1;
+		const int p3 = round ? 3 : -1;
+		for (const auto& m : data)
+		{
+			w.add(m.name.c_str());
+			w.add("lat", m.lat, p);
+			w.add("lon", m.lon, p);
+			w.add("alt", m.alt, p2);
+			w.add("speed", m.speed, p2);
+			w.add_arr("vel");
+			for (double v : m.vel)
+				w.add_item(v, p3);
+			w.end();
+			w.add("count", m.count);
+			w.add("ms", m.ms);
+			w.add("ok", m.ok);
+			w.add("status", m.status);
+			w.end();
+		}
+	}
+
+	// Команда: параметры каждого модуля.
+	std::string make_cmd(size_t n)
+	{
+		std::string cmd = "{";
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (i > 0)
+				cmd += ',';
+			cmd += "\"m" + std::to_string(i) + "\":{\"rate\":" + std::to_string(1 + i % 50) +
+				",\"enable\":true,\"mode\":\"auto\",\"gain\":[0.5,1.25,2.0]}";
+		}
+		cmd += '}';
+		return cmd;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::array<size_struct, 5> sizes = {{
+		{"small", 1, 100000},
+		{"medium", 10, 20000},
+		{"large", 100, 2000},
+		{"huge", 1000, 200},
+		{"max", 5000, 40}
+	}};
+	std::vector<app::bench::result_struct> res;
+	auto run = [&res](const std::string& name, size_t iter, auto&& f)
+	{
+		res.push_back(app::bench::run(name.c_str(), iter, f));
+		app::bench::print(res.back());
+	};
+
+	app::bench::print_head();
+	for (const auto& s : sizes)
+	{
+		const std::vector<module_struct> data = make_data(s.modules);
+		const std::string tag = std::string(" ") + s.name;
+		const size_t arena = 1024 * 1024 * 8;
+		app::Json json(9, arena, arena);
+		app::JsonWriter writer;
+		app::SimpleJson simple;
+		app::Cbor cbor;
+		size_t len = 0;
+
+		// Формирование.
+		run("json.set+end" + tag, s.iter, [&]()
+		{
+			json.beg();
+			fill(json, data, false);
+			json.end(len);
+			return len;
+		});
+		run("json.set(round)+end" + tag, s.iter, [&]()
+		{
+			json.beg();
+			fill(json, data, true);
+			json.end(len);
+			return len;
+		});
+		json.delta(true);
+		run("json.set(round)+end_delta" + tag, s.iter, [&]()
+		{
+			json.beg();
+			fill(json, data, true);
+			json.end_delta(len, false);
+			return len;
+		});
+		json.delta(false);
+		run("json_writer" + tag, s.iter, [&]()
+		{
+			writer.beg();
+			fill(writer, data, false);
+			writer.end(len);
+			return len;
+		});
+		run("json_writer(round)" + tag, s.iter, [&]()
+		{
+			writer.beg();
+			fill(writer, data, true);
+			writer.end(len);
+			return len;
+		});
+		run("simple_json" + tag, s.iter, [&]()
+		{
+			simple.add();
+			fill(simple, data, false);
+			simple.end();
+			return simple.size();
+		});
+		run("simple_json(round)" + tag, s.iter, [&]()
+		{
+			simple.add();
+			fill(simple, data, true);
+			simple.end();
+			return simple.size();
+		});
+		run("cbor(round)" + tag, s.iter, [&]()
+		{
+			cbor.beg();
+			fill(cbor, data, true);
+			cbor.end(len);
+			return len;
+		});
+		json.beg();
+		fill(json, data, true);
+		const std::string text = json.end();
+		run("json.accept(cbor)" + tag, s.iter, [&]()
+		{
+			cbor.clear();
+			json.accept(cbor);
+			return cbor.size();
+		});
+
+		// Разбор телеметрии.
+		run("json.parse" + tag, s.iter, [&]()
+		{
+			json.parse(text.c_str(), text.size());
+			return text.size();
+		});
+		// Время включает копирование строки в буфер разбора.
+		std::vector<char> buf(text.size() + 1);
+		run("json.parse_insitu" + tag, s.iter, [&]()
+		{
+			std::memcpy(buf.data(), text.c_str(), text.size() + 1);
+			json.parse_insitu(buf.data());
+			return text.size();
+		});
+
+		// Разбор команды и чтение параметров.
+		const std::string cmd = make_cmd(s.modules);
+		run("cmd.parse+get" + tag, s.iter, [&]()
+		{
+			json.parse(cmd.c_str(), cmd.size());
+			int sum = 0;
+			for (const auto& m : data)
+			{
+				if (!json.get(m.section.c_str()))
+					continue;
+				int rate = 0;
+				bool enable = false;
+				std::string mode;
+				std::array<double, 3> gain;
+				json.get("rate", rate);
+				json.get("enable", enable);
+				json.get("mode", mode);
+				json.get("gain", gain);
+				sum += rate;
+			}
+			app::bench::_::keep(sum);
+			return cmd.size();
+		});
+
+		// Размер данных в разных форматах.
+		std::printf("%-40s json %zu B, simple_json %zu B, cbor %zu B\n",
+			("size" + tag).c_str(), text.size(), simple.size(), cbor.size());
+	}
+
+	if (argc > 1)
+	{
+		FILE* file = std::fopen(argv[1], "w");
+		if (!file)
+		{
+			std::cout << "Could not open file: " << argv[1] << std::endl;
+			return 1;
+		}
+		app::bench::print_csv(res, file);
+		std::fclose(file);
+	}
+	return 0;
+}
\ No newline at end of file
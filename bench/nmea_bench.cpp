@@ -0,0 +1,219 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+// Сравнение разбора числовых полей NMEA (GGA, RMC): atof/atoi и app::num (std::from_chars).
+// Сборка и запуск (из корня репозитория):
+// g++ -std=c++17 -O2 -I include bench/nmea_bench.cpp -o nmea_bench
+// ./nmea_bench [result.csv]
+//
+// fields - только разбор полей уже принятого сообщения,
+// update - приём сообщения (NMEA::update, проверка crc) и разбор полей.
+
+#define APP_BENCH_ALLOC
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "app/bench.h"
+#include "app/nmea.h"
+
+
+namespace
+{
+	// Сообщения GGA и RMC от приёмников (crc пересчитывается).
+	const std::array<const char*, 4> msgs = {{
+		"$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*00\r\n",
+		"$GNGGA,092725.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,*00\r\n",
+		"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*00\r\n",
+		"$GNRMC,083559.00,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A*00\r\n"
+	}};
+
+	// Числовые поля сообщения (номер поля, целое).
+	struct field_struct
+	{
+		uint16_t idx;
+		bool is_int;
+	};
+
+	const std::array<field_struct, 7> gga = {{
+		{1, false}, {2, false}, {4, false}, {6, true}, {7, true}, {8, false}, {9, false}
+	}};
+
+	const std::array<field_struct, 7> rmc = {{
+		{1, false}, {3, false}, {5, false}, {7, false}, {8, false}, {9, true}, {10, false}
+	}};
+
+	std::vector<std::string> make_data()
+	{
+		std::vector<std::string> data;
+		for (const char* msg : msgs)
+		{
+			std::string str = msg;
+			app::NMEA::calc_crc(&str[0], str.size() - 2);
+			data.push_back(str);
+		}
+		return data;
+	}
+
+	const field_struct* fields(const app::NMEA& nmea, size_t& n)
+	{
+		n = 0;
+		if (nmea.size() < 12)
+			return nullptr;
+		const char* name = nmea.get_str(0);
+		if (std::strcmp(name + 2, "GGA") == 0)
+		{
+			n = gga.size();
+			return gga.data();
+		}
+		if (std::strcmp(name + 2, "RMC") == 0)
+		{
+			n = rmc.size();
+			return rmc.data();
+		}
+		return nullptr;
+	}
+
+	// Прежний разбор (atof/atoi).
+	double sum_atof(const app::NMEA& nmea)
+	{
+		size_t n;
+		const field_struct* f = fields(nmea, n);
+		double sum = 0.0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			const char* str = nmea.get_str(f[i].idx);
+			sum += f[i].is_int ? std::atoi(str) : std::atof(str);
+		}
+		return sum;
+	}
+
+	// NMEA::get_double, NMEA::get_int (app::num::lead).
+	double sum_lead(const app::NMEA& nmea)
+	{
+		size_t n;
+		const field_struct* f = fields(nmea, n);
+		double sum = 0.0;
+		for (size_t i = 0; i < n; ++i)
+			sum += f[i].is_int ? nmea.get_int(f[i].idx) : nmea.get_double(f[i].idx);
+		return sum;
+	}
+
+	// NMEA::get с проверкой ошибок (app::num::parse).
+	double sum_parse(const app::NMEA& nmea)
+	{
+		size_t n;
+		const field_struct* f = fields(nmea, n);
+		double sum = 0.0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (f[i].is_int)
+			{
+				int val = 0;
+				nmea.get(f[i].idx, val);
+				sum += val;
+			}
+			else
+			{
+				double val = 0.0;
+				nmea.get(f[i].idx, val);
+				sum += val;
+			}
+		}
+		return sum;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t iter = 200000;
+	const std::vector<std::string> data = make_data();
+	std::vector<app::bench::result_struct> res;
+	auto run = [&res](const std::string& name, size_t iter, auto&& f)
+	{
+		res.push_back(app::bench::run(name.c_str(), iter, f));
+		app::bench::print(res.back());
+	};
+
+	// Принятые сообщения.
+	std::vector<app::NMEA> parsed(data.size());
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data[i].data());
+		if (!parsed[i].update(ptr, data[i].size()))
+		{
+			std::cout << "Could not parse: " << data[i];
+			return 1;
+		}
+		// Результаты разных способов должны совпадать.
+		const double a = sum_atof(parsed[i]);
+		if (a != sum_lead(parsed[i]) || a != sum_parse(parsed[i]))
+		{
+			std::cout << "Result mismatch: " << data[i];
+			return 1;
+		}
+	}
+	size_t bytes = 0;
+	for (const auto& str : data)
+		bytes += str.size();
+
+	app::bench::print_head();
+	run("fields atof/atoi", iter, [&]()
+	{
+		double sum = 0.0;
+		for (const auto& nmea : parsed)
+			sum += sum_atof(nmea);
+		app::bench::_::keep(sum);
+		return bytes;
+	});
+	run("fields get_double/get_int", iter, [&]()
+	{
+		double sum = 0.0;
+		for (const auto& nmea : parsed)
+			sum += sum_lead(nmea);
+		app::bench::_::keep(sum);
+		return bytes;
+	});
+	run("fields get(idx, val)", iter, [&]()
+	{
+		double sum = 0.0;
+		for (const auto& nmea : parsed)
+			sum += sum_parse(nmea);
+		app::bench::_::keep(sum);
+		return bytes;
+	});
+
+	app::NMEA nmea;
+	auto update = [&](auto&& sum_f)
+	{
+		double sum = 0.0;
+		// update вызывается до false (продолжает разбор того же буфера после сообщения).
+		for (const auto& str : data)
+		{
+			while (nmea.update(reinterpret_cast<const uint8_t*>(str.data()), str.size()))
+				sum += sum_f(nmea);
+		}
+		app::bench::_::keep(sum);
+		return bytes;
+	};
+	run("update atof/atoi", iter, [&]() { return update(sum_atof); });
+	run("update get_double/get_int", iter, [&]() { return update(sum_lead); });
+	run("update get(idx, val)", iter, [&]() { return update(sum_parse); });
+
+	if (argc > 1)
+	{
+		FILE* file = std::fopen(argv[1], "w");
+		if (!file)
+		{
+			std::cout << "Could not open file: " << argv[1] << std::endl;
+			return 1;
+		}
+		app::bench::print_csv(res, file);
+		std::fclose(file);
+	}
+	return 0;
+}
\ No newline at end of file
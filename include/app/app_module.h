@@ -4,11 +4,16 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
+#include "cbor.h"
 #include "config.h"
 #include "imodule.h"
+#include "json_writer.h"
+#include "math.h"
+#include "metrics.h"
 #include "print.h"
 #include "rate.h"
 #include "ws_server.h"
@@ -21,15 +26,196 @@ namespace app
 	class AppModule
 	{
 	private:
+		// Период отправки группы подписки.
+		struct sub_rate_struct
+		{
+			uint32_t ms = 0;
+			app::Rate rate;
+		};
+
 		app::Config _cfg;
 		app::WSServer _ws_server;
 		app::Json _json;
+		app::JsonWriter _json_writer;
+		app::Cbor _cbor;
+		std::vector<char> _ws_data; // Полученное сообщение (разбирается на месте).
 		app::Rate _rate;
 		app::Rate _rate_send;
 		std::vector<std::shared_ptr<IModule<TState>>> _modules;
+		std::vector<app::metrics::Metric*> _m_module; // Время обновления модулей.
+		app::metrics::Metric& _m_update = app::metrics::summary("app_update_seconds", "Main loop work time per cycle");
+		app::metrics::Metric& _m_late = app::metrics::counter("app_update_late_total", "Cycles that took longer than the period");
+		app::metrics::Metric& _m_send = app::metrics::summary("app_send_seconds", "Telemetry build and serialization time");
+		app::metrics::Metric& _m_msg = app::metrics::counter("app_msg_total", "Commands received");
+		app::metrics::Metric& _m_parse_error = app::metrics::counter("app_json_parse_error_total", "Commands with invalid json");
+		uint64_t _period_ns = 0;
 		bool _debug = false;
+		bool _delta = false;         // Отправка только изменившихся значений.
+		uint32_t _delta_full = 0;    // Период отправки полного снимка (сообщений), 0 - только по запросу.
+		uint32_t _delta_count = 0;
+		bool _resync = false;        // Запрос полного снимка от клиента.
+		bool _cbor_warn = false;     // Сообщение об отсутствии send_stream(Cbor) уже выведено.
+		uint32_t _period_send = 100;
+		app::Json _json_sub;         // Данные для подписок, если основная отправка не требуется.
+		std::vector<app::WSServer::sub_struct> _subs; // Группы подписки, которым пора отправлять данные.
+		std::vector<sub_rate_struct> _sub_rate;
+		bool _stamp = false;         // Номер рассылки и время формирования в секции ws.
+		bool _ws_stats = false;      // Статистика клиентов WebSocket в секции ws.
+		std::vector<app::WSServer::client_stat> _ws_clients;
 		TState _state;
 
+		// Отбор групп подписки, которым пора отправлять данные.
+		bool _sub_due()
+		{
+			if (!_ws_server.subs(_subs))
+				return false;
+			size_t n = 0;
+			for (size_t i = 0; i < _subs.size(); ++i)
+			{
+				auto& sub = _subs[i];
+				if (_sub_rate.size() <= sub.group)
+					_sub_rate.resize(sub.group + 1);
+				auto& r = _sub_rate[sub.group];
+				const uint32_t ms = sub.ms > 0 ? sub.ms : _period_send;
+				bool due;
+				if (r.ms != ms)
+				{
+					// Новая подписка: первая отправка сразу.
+					r.ms = ms;
+					r.rate.ms(ms);
+					due = true;
+				}
+				else
+					due = r.rate.ok();
+				if (!due)
+					continue;
+				if (n != i)
+					_subs[n] = std::move(sub);
+				++n;
+			}
+			_subs.resize(n);
+			return n > 0;
+		}
+
+		// Секция ws: номер рассылки (seq), время формирования (ts, мс unix),
+		// статистика клиентов (массивы по клиентам: id, время ответа на ping, ожидание в очереди отправки).
+		template <typename TWriter>
+		void _set_ws(TWriter& w, uint64_t seq)
+		{
+			if (!_stamp && !_ws_stats)
+				return;
+			w.set("/ws");
+			if (_stamp)
+			{
+				const auto ts = std::chrono::system_clock::now().time_since_epoch();
+				w.set("seq", seq);
+				w.set("ts", static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(ts).count()));
+			}
+			if (_ws_stats)
+			{
+				_ws_clients = _ws_server.clients();
+				const size_t n = _ws_clients.size();
+				std::vector<uint64_t> id(n);
+				std::vector<double> rtt(n);
+				std::vector<double> lag(n);
+				std::vector<uint64_t> drop(n);
+				for (size_t i = 0; i < n; ++i)
+				{
+					const auto& client = _ws_clients[i];
+					id[i] = client.id;
+					rtt[i] = math::round(1e-6 * static_cast<double>(client.rtt_ns), 2);
+					lag[i] = math::round(1e-6 * static_cast<double>(client.lag_ns), 2);
+					drop[i] = client.drop;
+				}
+				w.set("id", id);
+				w.set("rtt_ms", rtt);
+				w.set("lag_ms", lag);
+				w.set("drop", drop);
+			}
+		}
+
+		// Формирование и отправка данных.
+		void _send()
+		{
+			const uint64_t t = app::time::ns();
+			const bool is_sub = _sub_due();
+			const bool is_send = _rate_send.ok();
+			if (!is_send && !is_sub)
+				return;
+			app::Json* json_sub = nullptr; // Сформированный документ для подписок.
+			if (is_send)
+			{
+				bool new_connect = _ws_server.is_ws_new();
+				_json_writer.beg();
+				if (send_stream(_json_writer, _state, new_connect))
+				{
+					_set_ws(_json_writer, _ws_server.seq() + 1);
+					_ws_server.set_json(_json_writer.end());
+					// Клиенты с бинарным форматом: те же данные формируются в CBOR.
+					if (_ws_server.is_cbor())
+					{
+						_cbor.beg();
+						if (send_stream(_cbor, _state, new_connect))
+						{
+							_set_ws(_cbor, _ws_server.seq());
+							size_t len = 0;
+							const uint8_t* data = _cbor.end(len);
+							_ws_server.set_cbor(data, len);
+						}
+						else if (!_cbor_warn)
+						{
+							_cbor_warn = true;
+							app::print_error("send_stream(Cbor) not implemented: CBOR clients get no data");
+						}
+					}
+				}
+				else
+				{
+					json_sub = &_json;
+					_json.beg();
+					send_data(_json, _state, new_connect);
+					_set_ws(_json, _ws_server.seq() + 1);
+					if (_delta)
+					{
+						// Полный снимок: новый клиент, запрос клиента или пропуск кадра сервером.
+						bool full = _ws_server.is_full_req() || new_connect || _resync;
+						if (_delta_full > 0 && ++_delta_count >= _delta_full)
+							full = true;
+						if (full)
+						{
+							_resync = false;
+							_delta_count = 0;
+						}
+						std::string data = _json.end_delta(full);
+						_ws_server.set_delta(std::move(data), _json.is_delta_full());
+					}
+					else
+						_ws_server.set_json(_json.end());
+					// Клиенты с бинарным форматом получают полный снимок в CBOR.
+					if (_ws_server.is_cbor())
+					{
+						_cbor.clear();
+						_json.accept(_cbor);
+						_ws_server.set_cbor(_cbor.data(), _cbor.size());
+					}
+				}
+			}
+			// Группы подписки: документ формируется один раз, каждой группе отправляются её секции.
+			if (is_sub)
+			{
+				if (!json_sub)
+				{
+					_json_sub.beg();
+					send_data(_json_sub, _state, false);
+					_set_ws(_json_sub, _ws_server.seq());
+					json_sub = &_json_sub;
+				}
+				for (const auto& sub : _subs)
+					_ws_server.set_json(sub.group, json_sub->end(sub.sections));
+			}
+			_m_send.observe_ns(app::time::ns() - t);
+		}
+
 	public:
 		virtual ~AppModule()
 		{
@@ -55,9 +241,19 @@ namespace app
 				return false;
 			}
 			_cfg.section("app");
-			_rate.ms(_cfg.get<uint32_t>("period", 10));
-			_rate_send.ms(_cfg.get<uint32_t>("period_send", 100));
+			const uint32_t period = _cfg.get<uint32_t>("period", 10);
+			_rate.ms(period);
+			_period_ns = period * 1000000ULL;
+			_period_send = _cfg.get<uint32_t>("period_send", _period_send);
+			_rate_send.ms(_period_send);
 			_debug = _cfg.get("debug", _debug);
+			_json.arena(_cfg.get<uint32_t>("json_get_size", 65536), _cfg.get<uint32_t>("json_set_size", 65536));
+			_json_sub.arena(1024, _cfg.get<uint32_t>("json_set_size", 65536));
+			_delta = _cfg.get("delta", _delta);
+			_delta_full = _cfg.get("delta_full", _delta_full);
+			_json.delta(_delta);
+			_stamp = _cfg.get("stamp", _stamp);
+			_ws_stats = _cfg.get("ws_stats", _ws_stats);
 			_state.ns = app::time::ns();
 			_state.ms = static_cast<uint32_t>(_state.ns / 1000000);
 			return true;
@@ -79,6 +275,8 @@ namespace app
 				return app::print_error("Module not started: ", name.c_str());
 			// Добавление модуля.
 			_modules.push_back(mod);
+			const std::string metric = "app_module_update_seconds{module=\"" + name + "\"}";
+			_m_module.push_back(&app::metrics::summary(metric.c_str(), "Module update time"));
 			return true;
 		}
 
@@ -86,6 +284,21 @@ namespace app
 		{
 		}
 
+		// Потоковое формирование данных для отправки без построения DOM.
+		// Если возвращает false, то используется send_data.
+		virtual bool send_stream(app::JsonWriter&, TState&, bool)
+		{
+			return false;
+		}
+
+		// Потоковое формирование данных для клиентов с форматом CBOR (тот же API, что у JsonWriter).
+		// Вызывается после send_stream(JsonWriter), если есть такие клиенты.
+		// Обычно обе функции вызывают одну шаблонную функцию формирования данных.
+		virtual bool send_stream(app::Cbor&, TState&, bool)
+		{
+			return false;
+		}
+
 		void update()
 		{
 			_rate.wait();
@@ -95,26 +308,49 @@ namespace app
 			_state.ms = static_cast<uint32_t>(_state.ns / 1000000);
 			//
 			const size_t size = _modules.size();
+			uint64_t t = ns;
 			for (size_t i = 0; i < size; ++i)
+			{
 				_modules[i]->update(_state, dt);
+				const uint64_t now = app::time::ns();
+				_m_module[i]->observe_ns(now - t);
+				t = now;
+			}
 			//
-			if (_ws_server.is_json())
+			// Обработка всех полученных сообщений в порядке поступления.
+			bool is_get = false;
+			unsigned long id;
+			while (_ws_server.get_json(_ws_data, id))
 			{
-				if (!_json.parse(_ws_server.get_json().c_str()))
+				is_get = true;
+				_m_msg.inc();
+				if (!_json.parse_insitu(_ws_data.data()))
+				{
+					_m_parse_error.inc();
 					_json.print_error();
-				else
+					continue;
+				}
+				if (_json.is("resync"))
+					_resync = true;
+				// Подписка: {"sub":{"sections":["gps"],"ms":1000}}.
+				if (_json.get_beg("sub"))
 				{
-					for (size_t i = 0; i < size; ++i)
-						_modules[i]->param(_json, _state);
+					std::vector<std::string> sections;
+					uint32_t ms = 0;
+					_json.get("sections", sections);
+					_json.get("ms", ms);
+					_ws_server.subscribe(id, std::move(sections), ms);
 				}
+				_json.get_end();
+				for (size_t i = 0; i < size; ++i)
+					_modules[i]->param(_json, _state);
 			}
-			else if (_rate_send.ok())
-			{
-				bool new_connect = _ws_server.is_ws_new();
-				_json.beg();
-				send_data(_json, _state, new_connect);
-				_ws_server.set_json(_json.end());
-			}
+			if (!is_get)
+				_send();
+			const uint64_t work = app::time::ns() - ns;
+			_m_update.observe_ns(work);
+			if (work > _period_ns)
+				_m_late.inc();
 		}
 
 		void end()
@@ -122,6 +358,14 @@ namespace app
 			const size_t size = _modules.size();
 			for (size_t i = 0; i < size; ++i)
 				_modules[i]->end();
+			if (_debug)
+			{
+				const auto& get = _json.arena_get();
+				const auto& set = _json.arena_set();
+				std::cout << "json get arena: " << get.peak << " / " << get.size << (get.heap ? " (heap)" : "") << std::endl;
+				std::cout << "json set arena: " << set.peak << " / " << set.size << (set.heap ? " (heap)" : "") << std::endl;
+				std::cout << "ws get queue: peak " << _ws_server.get_peak() << ", overflow " << _ws_server.get_overflow() << std::endl;
+			}
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,156 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+// Измерение производительности: время одного вызова (процентили), пропускная способность
+// и количество выделений памяти на вызов.
+// Выделения памяти считаются, если перед подключением файла определить APP_BENCH_ALLOC
+// (заменяется глобальный operator new, поэтому только в одном файле программы).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "time.h"
+
+
+namespace app
+{
+	namespace bench
+	{
+		namespace _
+		{
+			std::atomic<uint64_t> alloc_num{0};
+			std::atomic<uint64_t> alloc_size{0};
+
+			// Значение не выбрасывается оптимизатором.
+			template <typename T>
+			void keep(const T& val)
+			{
+				asm volatile("" : : "g"(&val) : "memory");
+			}
+		}
+
+		// Результат измерения.
+		struct result_struct
+		{
+			std::string name;
+			size_t iter = 0;       // Количество вызовов.
+			size_t bytes = 0;      // Размер данных одного вызова (байт).
+			double mean = 0.0;     // Среднее время (нс).
+			double p50 = 0.0;      // Процентили времени (нс).
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+			double mb_s = 0.0;     // Пропускная способность (МБ/с).
+			double alloc = 0.0;    // Выделений памяти на вызов.
+			double alloc_b = 0.0;  // Байт выделено на вызов.
+		};
+
+		// Количество выделений памяти с начала работы программы.
+		uint64_t alloc_num()
+		{
+			return _::alloc_num.load(std::memory_order_relaxed);
+		}
+
+		// Объём выделенной памяти с начала работы программы (байт).
+		uint64_t alloc_size()
+		{
+			return _::alloc_size.load(std::memory_order_relaxed);
+		}
+
+		// Измерение функции f.
+		// f() возвращает размер обработанных данных (байт), он используется для расчёта пропускной способности.
+		// Первые warmup вызовов не учитываются.
+		template <typename F>
+		result_struct run(const char* name, size_t iter, F&& f, size_t warmup = 100)
+		{
+			result_struct res;
+			res.name = name;
+			res.iter = iter;
+			for (size_t i = 0; i < warmup; ++i)
+				_::keep(f());
+			std::vector<uint64_t> ns(iter);
+			size_t bytes = 0;
+			const uint64_t num = alloc_num();
+			const uint64_t size = alloc_size();
+			uint64_t total = 0;
+			for (size_t i = 0; i < iter; ++i)
+			{
+				const uint64_t t = time::now();
+				bytes = f();
+				ns[i] = time::now() - t;
+				_::keep(bytes);
+				total += ns[i];
+			}
+			if (iter == 0)
+				return res;
+			res.alloc = static_cast<double>(alloc_num() - num) / iter;
+			res.alloc_b = static_cast<double>(alloc_size() - size) / iter;
+			res.bytes = bytes;
+			std::sort(ns.begin(), ns.end());
+			auto pct = [&ns](double p)
+			{
+				return static_cast<double>(ns[std::min(ns.size() - 1, static_cast<size_t>(p * ns.size()))]);
+			};
+			res.mean = static_cast<double>(total) / iter;
+			res.p50 = pct(0.5);
+			res.p90 = pct(0.9);
+			res.p99 = pct(0.99);
+			res.max = static_cast<double>(ns.back());
+			if (res.mean > 0.0)
+				res.mb_s = bytes * 1e3 / res.mean;
+			return res;
+		}
+
+		void print_head()
+		{
+			std::printf("%-40s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+				"name", "bytes", "mean,ns", "p50,ns", "p90,ns", "p99,ns", "max,ns", "MB/s", "alloc");
+		}
+
+		void print(const result_struct& res)
+		{
+			std::printf("%-40s %9zu %9.0f %9.0f %9.0f %9.0f %9.0f %9.1f %9.1f\n",
+				res.name.c_str(), res.bytes, res.mean, res.p50, res.p90, res.p99, res.max, res.mb_s, res.alloc);
+		}
+
+		// Вывод в формате csv (для сравнения между версиями).
+		void print_csv(const std::vector<result_struct>& res, FILE* file = stdout)
+		{
+			std::fprintf(file, "name,bytes,mean_ns,p50_ns,p90_ns,p99_ns,max_ns,mb_s,alloc,alloc_bytes\n");
+			for (const auto& r : res)
+			{
+				std::fprintf(file, "%s,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f,%.2f,%.1f\n",
+					r.name.c_str(), r.bytes, r.mean, r.p50, r.p90, r.p99, r.max, r.mb_s, r.alloc, r.alloc_b);
+			}
+		}
+	}
+}
+
+#ifdef APP_BENCH_ALLOC
+void* operator new(size_t size)
+{
+	app::bench::_::alloc_num.fetch_add(1, std::memory_order_relaxed);
+	app::bench::_::alloc_size.fetch_add(size, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,417 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "math.h"
+#include "num.h"
+
+
+namespace app
+{
+	// Формирование данных в формате CBOR (RFC 8949).
+	// Интерфейс повторяет app::JsonWriter: секции задаются через set(path) (JSON Pointer),
+	// значения через set(name, val) и set(name, val, precision).
+	// Объекты и массивы кодируются с неопределённой длиной (0xBF/0x9F ... 0xFF).
+	// Также является SAX обработчиком rapidjson: app::Json::accept(cbor) перекодирует
+	// сформированный документ без промежуточного текста.
+	class Cbor
+	{
+	private:
+		std::vector<uint8_t> _buf;
+		size_t _size = 0;
+		std::string _path; // Текущая секция ("" - корень, "/a/b").
+
+		uint8_t* _push(size_t n)
+		{
+			if (_size + n > _buf.size())
+				_buf.resize((_size + n) * 2);
+			uint8_t* p = &_buf[_size];
+			_size += n;
+			return p;
+		}
+
+		void _byte(uint8_t b)
+		{
+			*_push(1) = b;
+		}
+
+		// Заголовок: основной тип и аргумент.
+		void _head(uint8_t major, uint64_t val)
+		{
+			major <<= 5;
+			if (val < 24)
+				_byte(static_cast<uint8_t>(major | val));
+			else if (val <= 0xFF)
+			{
+				uint8_t* p = _push(2);
+				p[0] = major | 24;
+				p[1] = static_cast<uint8_t>(val);
+			}
+			else if (val <= 0xFFFF)
+			{
+				uint8_t* p = _push(3);
+				p[0] = major | 25;
+				p[1] = static_cast<uint8_t>(val >> 8);
+				p[2] = static_cast<uint8_t>(val);
+			}
+			else if (val <= 0xFFFFFFFF)
+			{
+				uint8_t* p = _push(5);
+				p[0] = major | 26;
+				for (int i = 0; i < 4; ++i)
+					p[1 + i] = static_cast<uint8_t>(val >> (24 - 8 * i));
+			}
+			else
+			{
+				uint8_t* p = _push(9);
+				p[0] = major | 27;
+				for (int i = 0; i < 8; ++i)
+					p[1 + i] = static_cast<uint8_t>(val >> (56 - 8 * i));
+			}
+		}
+
+		void _float(float val)
+		{
+			uint32_t u;
+			std::memcpy(&u, &val, 4);
+			uint8_t* p = _push(5);
+			p[0] = 0xFA;
+			for (int i = 0; i < 4; ++i)
+				p[1 + i] = static_cast<uint8_t>(u >> (24 - 8 * i));
+		}
+
+		void _double(double val)
+		{
+			uint64_t u;
+			std::memcpy(&u, &val, 8);
+			uint8_t* p = _push(9);
+			p[0] = 0xFB;
+			for (int i = 0; i < 8; ++i)
+				p[1 + i] = static_cast<uint8_t>(u >> (56 - 8 * i));
+		}
+
+		void _str(uint8_t major, const char* str, size_t len)
+		{
+			_head(major, len);
+			if (len > 0)
+				std::memcpy(_push(len), str, len);
+		}
+
+		void _key(const char* name)
+		{
+			_str(3, name, std::strlen(name));
+		}
+
+		// Запись значения.
+		template <typename T>
+		void _val(const T& val)
+		{
+			if constexpr (std::is_same_v<T, bool>)
+				Bool(val);
+			else if constexpr (std::is_floating_point_v<T>)
+				Double(static_cast<double>(val));
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+				Int64(static_cast<int64_t>(val));
+			else if constexpr (std::is_integral_v<T>)
+				Uint64(static_cast<uint64_t>(val));
+			else
+				static_assert(std::is_arithmetic_v<T>, "app::Cbor: unsupported type");
+		}
+
+		void _val(const char* val)
+		{
+			_str(3, val, std::strlen(val));
+		}
+
+		void _val(const std::string& val)
+		{
+			_str(3, val.c_str(), val.size());
+		}
+
+		template <typename T>
+		void _val(const std::vector<T>& val)
+		{
+			_head(4, val.size());
+			for (size_t i = 0; i < val.size(); ++i)
+				_val(val[i]);
+		}
+
+		template <typename T, size_t N>
+		void _val(const std::array<T, N>& val)
+		{
+			_head(4, N);
+			for (size_t i = 0; i < N; ++i)
+				_val(val[i]);
+		}
+
+		// Число с округлением: float32, если его точности достаточно для precision.
+		// Отрицательная точность - без округления, больше 9 - ограничивается (размер math::_::factor).
+		void _round(double val, int p)
+		{
+			if (p < 0)
+			{
+				Double(val);
+				return;
+			}
+			p = std::min<int>(p, static_cast<int>(math::_::factor.size()) - 1);
+			val = math::round(val, p);
+			// Значения вне диапазона float (а также nan и inf) кодируются как float64.
+			if (!(std::fabs(val) <= FLT_MAX))
+			{
+				_double(val);
+				return;
+			}
+			const float f = static_cast<float>(val);
+			if (std::fabs(static_cast<double>(f) - val) * math::_::factor[p] <= 0.5)
+				_float(f);
+			else
+				_double(val);
+		}
+
+		template <typename T>
+		void _val_round(const T& val, const int p)
+		{
+			if constexpr (std::is_arithmetic_v<T>)
+				_round(static_cast<double>(val), p);
+			else
+			{
+				_head(4, val.size());
+				for (size_t i = 0; i < val.size(); ++i)
+					_round(static_cast<double>(val[i]), p);
+			}
+		}
+
+		// Закрытие секций до уровня len.
+		void _close(size_t len)
+		{
+			while (_path.size() > len)
+			{
+				_path.resize(_path.rfind('/'));
+				_byte(0xFF);
+			}
+		}
+
+	public:
+		Cbor(size_t size = 4096)
+		{
+			_buf.resize(size);
+		}
+
+		// Очистка буфера (для использования в качестве SAX обработчика).
+		void clear()
+		{
+			_size = 0;
+			_path.clear();
+		}
+
+		const uint8_t* data() const
+		{
+			return _buf.data();
+		}
+
+		size_t size() const
+		{
+			return _size;
+		}
+
+		// Начало формирования.
+		void beg()
+		{
+			clear();
+			_byte(0xBF);
+		}
+
+		// Окончание формирования.
+		const uint8_t* end(size_t& len)
+		{
+			_close(0);
+			_byte(0xFF);
+			len = _size;
+			return _buf.data();
+		}
+
+		// Переход в секцию (JSON Pointer: "" - корень, "/a/b").
+		// Секции, из которых выходим, закрываются.
+		void set(const char* name)
+		{
+			// Общая часть текущей и новой секции (по границе токена).
+			size_t len = 0;
+			size_t i = 0;
+			const size_t size = _path.size();
+			while (i < size && name[i] != '\0' && _path[i] == name[i])
+			{
+				++i;
+				if (i == size || _path[i] == '/')
+				{
+					if (name[i] == '\0' || name[i] == '/')
+						len = i;
+				}
+			}
+			_close(len);
+			// Открытие новых секций.
+			const char* p = name + len;
+			while (*p == '/')
+			{
+				const char* beg = p + 1;
+				const char* e = std::strchr(beg, '/');
+				if (!e)
+					e = beg + std::strlen(beg);
+				_str(3, beg, static_cast<size_t>(e - beg));
+				_byte(0xBF);
+				_path.append(p, e);
+				p = e;
+			}
+		}
+
+		// Вложенный объект в текущей секции. Возврат - set_end.
+		void set_beg(const char* name)
+		{
+			_key(name);
+			_byte(0xBF);
+			_path += '/';
+			_path += name;
+		}
+
+		// Закрытие вложенного объекта (set_beg) или текущей секции.
+		void set_end()
+		{
+			if (!_path.empty())
+				_close(_path.rfind('/'));
+		}
+
+		// Задание переменных.
+		template <typename T>
+		void set(const char* name, const T& val)
+		{
+			_key(name);
+			_val(val);
+		}
+
+		// Значение с округлением.
+		// precision = [0, 9], иначе ошибка.
+		template <typename T>
+		void set(const char* name, const T& val, int precision)
+		{
+			_key(name);
+			_val_round(val, precision);
+		}
+
+		// Задание массива.
+		void set_arr(const char* name, const double* val, size_t size)
+		{
+			_key(name);
+			_head(4, size);
+			for (size_t i = 0; i < size; ++i)
+				Double(val[i]);
+		}
+
+		// SAX обработчик (rapidjson).
+		bool Null()
+		{
+			_byte(0xF6);
+			return true;
+		}
+
+		bool Bool(bool b)
+		{
+			_byte(b ? 0xF5 : 0xF4);
+			return true;
+		}
+
+		bool Int(int i)
+		{
+			return Int64(i);
+		}
+
+		bool Uint(unsigned u)
+		{
+			return Uint64(u);
+		}
+
+		bool Int64(int64_t i)
+		{
+			if (i < 0)
+				_head(1, static_cast<uint64_t>(-(i + 1)));
+			else
+				_head(0, static_cast<uint64_t>(i));
+			return true;
+		}
+
+		bool Uint64(uint64_t u)
+		{
+			_head(0, u);
+			return true;
+		}
+
+		// Без потери точности значение кодируется как float32.
+		// Значения вне диапазона float (а также nan и inf) кодируются как float64.
+		bool Double(double d)
+		{
+			if (!(std::fabs(d) <= FLT_MAX))
+			{
+				_double(d);
+				return true;
+			}
+			const float f = static_cast<float>(d);
+			if (static_cast<double>(f) == d)
+				_float(f);
+			else
+				_double(d);
+			return true;
+		}
+
+		bool RawNumber(const char* str, unsigned len, bool)
+		{
+			double d = 0.0;
+			num::parse(str, str + len, d);
+			return Double(d);
+		}
+
+		bool String(const char* str, unsigned len, bool)
+		{
+			_str(3, str, len);
+			return true;
+		}
+
+		bool StartObject()
+		{
+			_byte(0xBF);
+			return true;
+		}
+
+		bool Key(const char* str, unsigned len, bool)
+		{
+			_str(3, str, len);
+			return true;
+		}
+
+		bool EndObject(unsigned)
+		{
+			_byte(0xFF);
+			return true;
+		}
+
+		bool StartArray()
+		{
+			_byte(0x9F);
+			return true;
+		}
+
+		bool EndArray(unsigned)
+		{
+			_byte(0xFF);
+			return true;
+		}
+	};
+}
\ No newline at end of file
@@ -5,68 +5,42 @@
 #pragma once
 
 #include <array>
+#include <cctype>
 #include <cstdint>
-#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
+#include "num.h"
 
 
 namespace app
 {
 	namespace _
 	{
+		// Преобразование фрагмента строки [beg, end) в значение.
+		// Пробелы в начале пропускаются (как strtod/strtoll).
 		template <typename T>
-		bool bstot(const char* const str, T& val)
-		{
-			char* e;
-			T v = static_cast<T>(std::strtoll(str, &e, 0));
-			if (*e != '\0')
-				return false;
-			val = v;
-			return true;
-		}
-
-		template <>
-		bool bstot(const char* const str, double& val)
-		{
-			char* e;
-			double v = std::strtod(str, &e);
-			if (*e != '\0')
-				return false;
-			val = v;
-			return true;
-		}
-
-		template <>
-		bool bstot(const char* const str, float& val)
+		bool bstot(const char* beg, const char* const end, T& val)
 		{
-			char* e;
-			float v = std::strtof(str, &e);
-			if (*e != '\0')
-				return false;
-			val = v;
-			return true;
+			while (beg != end && std::isspace(static_cast<unsigned char>(*beg)))
+				++beg;
+			return num::parse(beg, end, val) == num::err::OK;
 		}
 
 		template <>
-		bool bstot(const char* const str, bool& val)
+		bool bstot(const char* const beg, const char* const end, std::string& val)
 		{
-			char* e;
-			int v = static_cast<int>(std::strtol(str, &e, 10));
-			if (*e != '\0')
-				return false;
-			val = (v == 1);
+			val.assign(beg, end);
 			return true;
 		}
 
-		template <>
-		bool bstot(const char* const str, std::string& val)
+		// Преобразование строки в значение.
+		template <typename T>
+		bool bstot(const char* const str, T& val)
 		{
-			val = std::string(str);
-			return true;
+			return bstot(str, str + std::strlen(str), val);
 		}
 
 		void print_beg(const std::string& name, bool offset = true)
@@ -151,10 +125,8 @@ namespace app
 		{
 			if (*str == '\0')
 				return false;
-			const uint8_t buf_size = 16;
-			char buf[buf_size];
+			const char* beg = str;
 			T val;
-			uint8_t i = 0;
 			while (true)
 			{
 				const char c = *str;
@@ -166,23 +138,17 @@ namespace app
 					case ',':
 					case ';':
 					{
-						if (i > 0)
+						if (str > beg)
 						{
-							buf[i] = '\0';
-							i = 0;
-							if (!bstot<T>(buf, val))
+							if (!bstot<T>(beg, str, val))
 								return false;
 							item.emplace_back(val);
 						}
+						beg = str + 1;
 						break;
 					}
 					default:
-					{
-						buf[i++] = c;
-						if (i >= buf_size)
-							return false;
 						break;
-					}
 				}
 				if (c == '\0')
 					break;
@@ -7,6 +7,10 @@
 #include <array>
 #include <cmath>
 #include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #ifndef NDEBUG
 #define NDEBUG
@@ -22,14 +26,158 @@
 
 namespace app
 {
+	// Путь к секции json (JSON Pointer), разобранный один раз.
+	// Найденная при чтении секция запоминается до следующего разбора,
+	// поэтому повторный выбор секции сводится к одному обращению по указателю.
+	class JsonPath
+	{
+	private:
+		friend class Json;
+		std::string _str;
+		rapidjson::Pointer _ptr;
+		const void* _owner = nullptr;     // Документ, в котором найдена секция.
+		uint64_t _gen = 0;                // Номер разбора, в котором найдена секция.
+		rapidjson::Value* _val = nullptr; // Найденная секция.
+
+	public:
+		explicit JsonPath(const char* path) :
+			_str(path),
+			_ptr(path)
+		{
+		}
+
+		const std::string& str() const
+		{
+			return _str;
+		}
+	};
+
 	class Json
 	{
+	public:
+		// Использование памяти документа.
+		struct arena_stat
+		{
+			size_t size = 0;   // Размер предвыделенного буфера.
+			size_t used = 0;   // Использовано в последнем цикле.
+			size_t peak = 0;   // Максимум за всё время.
+			bool heap = false; // Буфера не хватило, память выделялась из кучи.
+		};
+
 	private:
-		rapidjson::Document _json;
+		using alloc_type = rapidjson::MemoryPoolAllocator<>;
+		using doc_type = rapidjson::GenericDocument<rapidjson::UTF8<>, alloc_type, alloc_type>;
+
+		// Документ, память которого берётся из предвыделенного буфера.
+		// Сброс (reset) не освобождает память, а только обнуляет пул.
+		struct arena_struct
+		{
+			std::vector<char> buf;       // Память для узлов документа.
+			std::vector<char> stack_buf; // Память для стека разбора.
+			alloc_type alloc;
+			alloc_type stack_alloc;
+			doc_type doc;
+			arena_stat stat;
+
+			arena_struct(size_t size) :
+				buf(size),
+				stack_buf(size / 4 + 1024),
+				alloc(buf.data(), buf.size()),
+				stack_alloc(stack_buf.data(), stack_buf.size()),
+				doc(&alloc, 1024, &stack_alloc)
+			{
+				stat.size = buf.size() + stack_buf.size();
+			}
+
+			// Документ заменяется новым до очистки пулов: стек разбора старого документа
+			// указывает в stack_alloc и не должен использоваться после очистки.
+			void reset()
+			{
+				doc_type(&alloc, 1024, &stack_alloc).Swap(doc);
+				alloc.Clear();
+				stack_alloc.Clear();
+			}
+
+			// Обновление статистики после цикла.
+			// Стек разбора выделяется заново в каждом цикле, поэтому учитывается в stack_alloc.Size().
+			void update()
+			{
+				stat.used = alloc.Size() + stack_alloc.Size();
+				if (stat.used > stat.peak)
+					stat.peak = stat.used;
+				if (alloc.Capacity() > buf.size() || stack_alloc.Capacity() > stack_buf.size())
+					stat.heap = true;
+			}
+		};
+
+		std::unique_ptr<arena_struct> _doc_get;                 // Документ для разбора.
+		std::unique_ptr<arena_struct> _doc_set;                 // Документ для формирования.
 		rapidjson::StringBuffer _buffer;
 		rapidjson::Writer<rapidjson::StringBuffer> _writer;
-		rapidjson::Value* _section = nullptr;               // Текущая секция для чтения.
+		rapidjson::Value* _get_section = nullptr;               // Текущая секция для чтения.
+		rapidjson::Value* _set_section = nullptr;               // Текущая секция для записи.
 		rapidjson::ParseResult _ok;
+		std::unique_ptr<arena_struct> _doc_prev;                // Последний отправленный документ (delta).
+		std::unordered_map<std::string, double> _eps;           // Допуск изменения значений (delta).
+		std::string _delta_key;                                 // Путь текущего значения (delta).
+		std::vector<const rapidjson::Value*> _delta_sec;        // Секции текущего значения (delta).
+		size_t _delta_open = 0;                                 // Количество уже записанных секций (delta).
+		uint64_t _seq = 0;                                      // Номер сообщения (delta).
+		bool _delta_full = false;                               // Последнее сообщение - полный снимок (delta).
+		uint64_t _gen = 0;                                      // Номер разбора.
+		// Кэш разобранных путей секций с вытеснением CLOCK.
+		struct path_slot
+		{
+			const char* key;
+			JsonPath path;
+			bool ref; // Путь использовался после последнего прохода стрелки.
+		};
+
+		std::unordered_map<const char*, size_t> _path;          // Разобранные пути секций (номер в _path_slot).
+		std::vector<path_slot> _path_slot;
+		size_t _path_hand = 0;                                  // Стрелка CLOCK.
+		size_t _path_limit = 4096;                              // Максимальный размер кэша путей.
+		std::vector<rapidjson::Value*> _get_stack;              // Родительские секции для чтения (get_beg).
+		std::vector<rapidjson::Value*> _set_stack;              // Родительские секции для записи (set_beg).
+
+		// Путь секции из кэша.
+		// Ключ - адрес строки (обычно литерал), совпадение текста проверяется.
+		// Ссылка действительна до следующего вызова.
+		JsonPath& _path_get(const char* name)
+		{
+			auto it = _path.find(name);
+			if (it != _path.end())
+			{
+				path_slot& slot = _path_slot[it->second];
+				slot.ref = true;
+				// По тому же адресу другая строка (временная строка).
+				if (slot.path._str != name)
+					slot.path = JsonPath(name);
+				return slot.path;
+			}
+			if (_path_slot.size() < _path_limit)
+			{
+				_path.emplace(name, _path_slot.size());
+				_path_slot.push_back({name, JsonPath(name), true});
+				return _path_slot.back().path;
+			}
+			// Защита от роста кэша при передаче временных строк:
+			// вытесняется путь, который не использовался за полный проход стрелки.
+			while (_path_slot[_path_hand].ref)
+			{
+				_path_slot[_path_hand].ref = false;
+				_path_hand = (_path_hand + 1) % _path_slot.size();
+			}
+			const size_t idx = _path_hand;
+			_path_hand = (_path_hand + 1) % _path_slot.size();
+			path_slot& slot = _path_slot[idx];
+			_path.erase(slot.key);
+			_path.emplace(name, idx);
+			slot.key = name;
+			slot.path = JsonPath(name);
+			slot.ref = true;
+			return slot.path;
+		}
 
 		// Получение значения.
 		template <typename T>
@@ -91,6 +239,21 @@ namespace app
 			return true;
 		}
 
+		// Получение списка строк из массива.
+		bool _get(const rapidjson::Value& json_val, std::vector<std::string>& val) const
+		{
+			if (!json_val.IsArray())
+				return false;
+			val.clear();
+			val.reserve(json_val.Size());
+			for (rapidjson::Value::ConstValueIterator itr = json_val.Begin(); itr != json_val.End(); ++itr)
+			{
+				if (itr->IsString())
+					val.emplace_back(itr->GetString(), itr->GetStringLength());
+			}
+			return !val.empty();
+		}
+
 		// Получение списка значений из массива.
 		template <typename T, size_t N>
 		bool _get(const rapidjson::Value& json_val, std::array<T, N>& val) const
@@ -110,9 +273,9 @@ namespace app
 		void _set(const char* name, rapidjson::Value& val, const bool key_copy = false)
 		{
 			if (key_copy)
-				_section->AddMember(rapidjson::Value(name, _json.GetAllocator()), val, _json.GetAllocator());
+				_set_section->AddMember(rapidjson::Value(name, _doc_set->doc.GetAllocator()), val, _doc_set->doc.GetAllocator());
 			else
-				_section->AddMember(rapidjson::StringRef(name), val, _json.GetAllocator());
+				_set_section->AddMember(rapidjson::StringRef(name), val, _doc_set->doc.GetAllocator());
 		}
 
 		void _round(double& val, const int p) const
@@ -134,12 +297,163 @@ namespace app
 				val[i] = math::round(val[i], p);
 		}
 
+		// Поиск поля в предыдущем документе.
+		// Порядок полей обычно не меняется, поэтому сначала проверяется тот же индекс.
+		rapidjson::Value::ConstMemberIterator _delta_find(const rapidjson::Value& prev, const rapidjson::Value& name, rapidjson::SizeType i) const
+		{
+			if (i < prev.MemberCount())
+			{
+				const auto it = prev.MemberBegin() + i;
+				if (it->name == name)
+					return it;
+			}
+			return prev.FindMember(name);
+		}
+
+		// Запись ключа изменившегося значения вместе с ещё не записанными секциями.
+		void _delta_write(const rapidjson::Value& name)
+		{
+			for (; _delta_open < _delta_sec.size(); ++_delta_open)
+			{
+				const rapidjson::Value* sec = _delta_sec[_delta_open];
+				_writer.Key(sec->GetString(), sec->GetStringLength());
+				_writer.StartObject();
+			}
+			_writer.Key(name.GetString(), name.GetStringLength());
+		}
+
+		// Сравнение значения с предыдущим.
+		// Если изменение не превышает допуск, то сохраняется предыдущее значение,
+		// чтобы медленный дрейф не терялся.
+		bool _delta_same(rapidjson::Value& cur, const rapidjson::Value& prev)
+		{
+			if (!_eps.empty() && cur.IsNumber() && prev.IsNumber())
+			{
+				const auto it = _eps.find(_delta_key);
+				if (it != _eps.end())
+				{
+					if (std::fabs(cur.GetDouble() - prev.GetDouble()) > it->second)
+						return false;
+					cur.SetDouble(prev.GetDouble());
+					return true;
+				}
+			}
+			return cur == prev;
+		}
+
+		// Запись изменившихся значений секции.
+		void _delta(rapidjson::Value& cur, const rapidjson::Value& prev)
+		{
+			rapidjson::SizeType i = 0;
+			rapidjson::SizeType found = 0;
+			for (auto it = cur.MemberBegin(); it != cur.MemberEnd(); ++it, ++i)
+			{
+				const size_t key_len = _delta_key.size();
+				if (!_eps.empty())
+				{
+					_delta_key += '/';
+					_delta_key.append(it->name.GetString(), it->name.GetStringLength());
+				}
+				const auto p = _delta_find(prev, it->name, i);
+				if (p == prev.MemberEnd())
+				{
+					_delta_write(it->name);
+					it->value.Accept(_writer);
+				}
+				else
+				{
+					++found;
+					if (it->value.IsObject() && p->value.IsObject())
+					{
+						_delta_sec.push_back(&it->name);
+						_delta(it->value, p->value);
+						if (_delta_open == _delta_sec.size())
+						{
+							_writer.EndObject();
+							--_delta_open;
+						}
+						_delta_sec.pop_back();
+					}
+					else if (!_delta_same(it->value, p->value))
+					{
+						_delta_write(it->name);
+						it->value.Accept(_writer);
+					}
+				}
+				_delta_key.resize(key_len);
+			}
+			// Удалённые значения.
+			if (found == prev.MemberCount())
+				return;
+			for (auto it = prev.MemberBegin(); it != prev.MemberEnd(); ++it)
+			{
+				if (cur.FindMember(it->name) != cur.MemberEnd())
+					continue;
+				_delta_write(it->name);
+				_writer.Null();
+			}
+		}
+
 	public:
 		// decimal - количество знаков после запятой.
-		Json(int decimal = 9) :
+		// get_size, set_size - размер памяти для разбора и формирования json (байт).
+		Json(int decimal = 9, size_t get_size = 65536, size_t set_size = 65536) :
 			_writer(_buffer)
 		{
 			set_decimal(decimal);
+			arena(get_size, set_size);
+		}
+
+		// Максимальный размер кэша путей секций (get(name), set(name)).
+		// Если различных секций больше, то пути разбираются заново при каждом обращении.
+		void path_cache(size_t size)
+		{
+			_path_limit = size > 0 ? size : 1;
+			_path.clear();
+			_path_slot.clear();
+			_path_hand = 0;
+		}
+
+		// Размер предвыделенной памяти для разбора и формирования json (байт).
+		// Текущие данные и статистика сбрасываются.
+		void arena(size_t get_size, size_t set_size)
+		{
+			_get_section = nullptr;
+			_set_section = nullptr;
+			++_gen;
+			_doc_get = std::make_unique<arena_struct>(get_size);
+			_doc_set = std::make_unique<arena_struct>(set_size);
+			if (_doc_prev)
+				_doc_prev = std::make_unique<arena_struct>(set_size);
+		}
+
+		// Режим delta: end_delta отправляет только изменившиеся значения.
+		// Для хранения последнего отправленного документа используется ещё один буфер.
+		void delta(bool use)
+		{
+			if (!use)
+				_doc_prev.reset();
+			else if (!_doc_prev)
+				_doc_prev = std::make_unique<arena_struct>(_doc_set->buf.size());
+		}
+
+		// Допуск изменения числового значения для режима delta.
+		// path - путь к значению ("/section/name").
+		void set_eps(const std::string& path, double eps)
+		{
+			_eps[path] = eps;
+		}
+
+		// Использование памяти при разборе.
+		const arena_stat& arena_get() const
+		{
+			return _doc_get->stat;
+		}
+
+		// Использование памяти при формировании.
+		const arena_stat& arena_set() const
+		{
+			return _doc_set->stat;
 		}
 
 		// decimal - количество знаков после запятой.
@@ -153,7 +467,11 @@ namespace app
 		// В случае успеха возвращает true.
 		bool parse(const char* data)
 		{
-			_ok = _json.Parse(data);
+			_doc_get->reset();
+			_get_stack.clear();
+			++_gen;
+			_ok = _doc_get->doc.Parse(data);
+			_doc_get->update();
 			if (!_ok)
 				return false;
 			return get("");
@@ -164,7 +482,27 @@ namespace app
 		// В случае успеха возвращает true.
 		bool parse(const char* data, size_t len)
 		{
-			_ok = _json.Parse(data, len);
+			_doc_get->reset();
+			_get_stack.clear();
+			++_gen;
+			_ok = _doc_get->doc.Parse(data, len);
+			_doc_get->update();
+			if (!_ok)
+				return false;
+			return get("");
+		}
+
+		// Разбор строки данных на месте (без копирования строк).
+		// data - строка данных, заканчивающаяся \0. Строка изменяется при разборе
+		// и должна существовать, пока используются полученные значения.
+		// В случае успеха возвращает true.
+		bool parse_insitu(char* data)
+		{
+			_doc_get->reset();
+			_get_stack.clear();
+			++_gen;
+			_ok = _doc_get->doc.ParseInsitu(data);
+			_doc_get->update();
 			if (!_ok)
 				return false;
 			return get("");
@@ -177,7 +515,11 @@ namespace app
 		{
 			std::ifstream ifs(file);
 			rapidjson::IStreamWrapper isw(ifs);
-			_ok = _json.ParseStream(isw);
+			_doc_get->reset();
+			_get_stack.clear();
+			++_gen;
+			_ok = _doc_get->doc.ParseStream(isw);
+			_doc_get->update();
 			if (!_ok)
 				return false;
 			return get("");
@@ -191,28 +533,65 @@ namespace app
 		// Есть ли данное поле.
 		bool has(const char* name) const
 		{
-			if (!_section)
+			if (!_get_section)
 				return false;
-			return _section->HasMember(name);
+			return _get_section->HasMember(name);
 		}
 
 		// Выбор секции.
 		bool get(const char* name)
 		{
-			_section = rapidjson::Pointer(name).Get(_json);
-			if (!_section || _section->IsNull())
+			return get(_path_get(name));
+		}
+
+		// Выбор секции по заранее разобранному пути.
+		bool get(JsonPath& path)
+		{
+			if (path._owner != this || path._gen != _gen)
+			{
+				path._val = path._ptr.Get(_doc_get->doc);
+				path._owner = this;
+				path._gen = _gen;
+			}
+			_get_section = path._val;
+			if (!_get_section || _get_section->IsNull())
 				return false;
 			return true;
 		}
 
+		// Переход во вложенный объект текущей секции для чтения.
+		// Возврат - get_end (вызывается в любом случае).
+		bool get_beg(const char* name)
+		{
+			_get_stack.push_back(_get_section);
+			rapidjson::Value* sec = nullptr;
+			if (_get_section)
+			{
+				const auto it = _get_section->FindMember(name);
+				if (it != _get_section->MemberEnd() && it->value.IsObject())
+					sec = &it->value;
+			}
+			_get_section = sec;
+			return sec != nullptr;
+		}
+
+		// Возврат в родительскую секцию для чтения.
+		void get_end()
+		{
+			if (_get_stack.empty())
+				return;
+			_get_section = _get_stack.back();
+			_get_stack.pop_back();
+		}
+
 		// Получение значения.
 		template <typename T>
 		bool get(const char* name, T& val) const
 		{
-			if (!_section)
+			if (!_get_section)
 				return false;
-			const auto it = _section->FindMember(name);
-			if (it == _section->MemberEnd())
+			const auto it = _get_section->FindMember(name);
+			if (it == _get_section->MemberEnd())
 				return false;
 			return _get(it->value, val);
 		}
@@ -221,10 +600,10 @@ namespace app
 		template <typename T>
 		bool get_change(const char* name, T& val) const
 		{
-			if (!_section)
+			if (!_get_section)
 				return false;
-			const auto it = _section->FindMember(name);
-			if (it == _section->MemberEnd())
+			const auto it = _get_section->FindMember(name);
+			if (it == _get_section->MemberEnd())
 				return false;
 			T old_val = val;
 			if (!_get(it->value, val))
@@ -243,7 +622,15 @@ namespace app
 		// Начало формирования json.
 		void beg()
 		{
-			_json.SetObject();
+			// В режиме delta сохраняем предыдущий документ.
+			if (_doc_prev)
+			{
+				_doc_prev.swap(_doc_set);
+				std::swap(_doc_prev->stat, _doc_set->stat);
+			}
+			_doc_set->reset();
+			_set_stack.clear();
+			_doc_set->doc.SetObject();
 			set("");
 		}
 
@@ -252,7 +639,8 @@ namespace app
 		{
 			_buffer.Clear();
 			_writer.Reset(_buffer);
-			_json.Accept(_writer);
+			_doc_set->doc.Accept(_writer);
+			_doc_set->update();
 			return std::string(_buffer.GetString(), _buffer.GetSize());
 		}
 
@@ -261,33 +649,139 @@ namespace app
 		{
 			_buffer.Clear();
 			_writer.Reset(_buffer);
-			_json.Accept(_writer);
+			_doc_set->doc.Accept(_writer);
+			_doc_set->update();
 			len = _buffer.GetSize();
 			return _buffer.GetString();
 		}
 
+		// Окончание формирования json: только перечисленные секции верхнего уровня.
+		// Пустой список - весь документ.
+		std::string end(const std::vector<std::string>& sections)
+		{
+			if (sections.empty())
+				return end();
+			_buffer.Clear();
+			_writer.Reset(_buffer);
+			_writer.StartObject();
+			const rapidjson::Value& doc = _doc_set->doc;
+			for (const auto& name : sections)
+			{
+				const auto it = doc.FindMember(rapidjson::Value(rapidjson::StringRef(name.c_str(), name.size())));
+				if (it == doc.MemberEnd())
+					continue;
+				_writer.Key(name.c_str(), static_cast<rapidjson::SizeType>(name.size()));
+				it->value.Accept(_writer);
+			}
+			_writer.EndObject();
+			_doc_set->update();
+			return std::string(_buffer.GetString(), _buffer.GetSize());
+		}
+
+		// Обход сформированного документа SAX обработчиком (например, app::Cbor).
+		template <typename THandler>
+		void accept(THandler& handler) const
+		{
+			_doc_set->doc.Accept(handler);
+		}
+
+		// Окончание формирования json в режиме delta.
+		// full - полный снимок, иначе только значения, изменившиеся с прошлого сообщения.
+		// Формат: {"seq":N,"full":true,"data":{...}}. Удалённые значения передаются как null.
+		// По номеру seq клиент может обнаружить пропуск и запросить полный снимок.
+		const char* end_delta(size_t& len, bool full)
+		{
+			_buffer.Clear();
+			_writer.Reset(_buffer);
+			_writer.StartObject();
+			_writer.Key("seq", 3);
+			_writer.Uint64(++_seq);
+			_delta_full = full || !_doc_prev || !_doc_prev->doc.IsObject();
+			if (_delta_full)
+			{
+				_writer.Key("full", 4);
+				_writer.Bool(true);
+				_writer.Key("data", 4);
+				_doc_set->doc.Accept(_writer);
+			}
+			else
+			{
+				_writer.Key("data", 4);
+				_writer.StartObject();
+				_delta_key.clear();
+				_delta_sec.clear();
+				_delta_open = 0;
+				_delta(_doc_set->doc, _doc_prev->doc);
+				_writer.EndObject();
+			}
+			_writer.EndObject();
+			_doc_set->update();
+			len = _buffer.GetSize();
+			return _buffer.GetString();
+		}
+
+		// Окончание формирования json в режиме delta.
+		std::string end_delta(bool full)
+		{
+			size_t len;
+			const char* data = end_delta(len, full);
+			return std::string(data, len);
+		}
+
+		// Последний end_delta сформировал полный снимок (в том числе без запроса, если нет предыдущего документа).
+		bool is_delta_full() const
+		{
+			return _delta_full;
+		}
+
 		// Добавление секции.
 		void set(const char* name)
 		{
-			_section = rapidjson::Pointer(name).Get(_json);
-			if (!_section || _section->IsNull())
+			set(_path_get(name));
+		}
+
+		// Добавление секции по заранее разобранному пути.
+		// Секция ищется каждый раз: добавление соседних полей может переместить её в памяти.
+		void set(const JsonPath& path)
+		{
+			_set_section = path._ptr.Get(_doc_set->doc);
+			if (!_set_section || _set_section->IsNull())
 			{
-				_section = &(rapidjson::Pointer(name).Create(_json));
-				_section->SetObject();
+				_set_section = &(path._ptr.Create(_doc_set->doc));
+				_set_section->SetObject();
 			}
 		}
 
+		// Добавление вложенного объекта в текущую секцию и переход в него.
+		// Возврат - set_end.
+		void set_beg(const char* name)
+		{
+			_set_stack.push_back(_set_section);
+			rapidjson::Value obj(rapidjson::kObjectType);
+			_set_section->AddMember(rapidjson::StringRef(name), obj, _doc_set->doc.GetAllocator());
+			_set_section = &(_set_section->MemberEnd() - 1)->value;
+		}
+
+		// Возврат в родительскую секцию для записи.
+		void set_end()
+		{
+			if (_set_stack.empty())
+				return;
+			_set_section = _set_stack.back();
+			_set_stack.pop_back();
+		}
+
 		// Задание массива.
 		template <typename T>
 		void set(const char* name, const std::vector<T>& val, const bool key_copy = false)
 		{
 			rapidjson::Value array(rapidjson::kArrayType);
 			for (size_t i = 0; i < val.size(); ++i)
-				array.PushBack(val[i], _json.GetAllocator());
+				array.PushBack(val[i], _doc_set->doc.GetAllocator());
 			if (key_copy)
-				_section->AddMember(rapidjson::Value(name, _json.GetAllocator()), array, _json.GetAllocator());
+				_set_section->AddMember(rapidjson::Value(name, _doc_set->doc.GetAllocator()), array, _doc_set->doc.GetAllocator());
 			else
-				_section->AddMember(rapidjson::StringRef(name), array, _json.GetAllocator());
+				_set_section->AddMember(rapidjson::StringRef(name), array, _doc_set->doc.GetAllocator());
 		}
 
 		// Задание массива.
@@ -296,7 +790,7 @@ namespace app
 		{
 			rapidjson::Value array(rapidjson::kArrayType);
 			for (size_t i = 0; i < N; ++i)
-				array.PushBack(val[i], _json.GetAllocator());
+				array.PushBack(val[i], _doc_set->doc.GetAllocator());
 			_set(name, array, key_copy);
 		}
 
@@ -307,12 +801,12 @@ namespace app
 			if (val_copy)
 			{
 				for (size_t i = 0; i < val.size(); ++i)
-					array.PushBack(rapidjson::Value(val[i].c_str(), _json.GetAllocator()), _json.GetAllocator());
+					array.PushBack(rapidjson::Value(val[i].c_str(), _doc_set->doc.GetAllocator()), _doc_set->doc.GetAllocator());
 			}
 			else
 			{
 				for (size_t i = 0; i < val.size(); ++i)
-					array.PushBack(rapidjson::StringRef(val[i].c_str()), _json.GetAllocator());
+					array.PushBack(rapidjson::StringRef(val[i].c_str()), _doc_set->doc.GetAllocator());
 			}
 			_set(name, array, key_copy);
 		}
@@ -322,17 +816,17 @@ namespace app
 		void set(const char* name, const T& val, const bool key_copy = false)
 		{
 			if (key_copy)
-				_section->AddMember(rapidjson::Value(name, _json.GetAllocator()), rapidjson::Value(val), _json.GetAllocator());
+				_set_section->AddMember(rapidjson::Value(name, _doc_set->doc.GetAllocator()), rapidjson::Value(val), _doc_set->doc.GetAllocator());
 			else
-				_section->AddMember(rapidjson::StringRef(name), val, _json.GetAllocator());
+				_set_section->AddMember(rapidjson::StringRef(name), val, _doc_set->doc.GetAllocator());
 		}
 
 		void set(const char* name, const std::string& val, const bool key_copy = false)
 		{
 			if (key_copy)
-				_section->AddMember(rapidjson::Value(name, _json.GetAllocator()), rapidjson::Value(val.c_str(), _json.GetAllocator()), _json.GetAllocator());
+				_set_section->AddMember(rapidjson::Value(name, _doc_set->doc.GetAllocator()), rapidjson::Value(val.c_str(), _doc_set->doc.GetAllocator()), _doc_set->doc.GetAllocator());
 			else
-				_section->AddMember(rapidjson::StringRef(name), rapidjson::Value(val.c_str(), _json.GetAllocator()), _json.GetAllocator());
+				_set_section->AddMember(rapidjson::StringRef(name), rapidjson::Value(val.c_str(), _doc_set->doc.GetAllocator()), _doc_set->doc.GetAllocator());
 		}
 
 		// Значение с округлением.
@@ -349,11 +843,11 @@ namespace app
 		{
 			rapidjson::Value array(rapidjson::kArrayType);
 			for (size_t i = 0; i < size; ++i)
-				array.PushBack(val[i], _json.GetAllocator());
+				array.PushBack(val[i], _doc_set->doc.GetAllocator());
 			if (key_copy)
-				_section->AddMember(rapidjson::Value(name, _json.GetAllocator()), array, _json.GetAllocator());
+				_set_section->AddMember(rapidjson::Value(name, _doc_set->doc.GetAllocator()), array, _doc_set->doc.GetAllocator());
 			else
-				_section->AddMember(rapidjson::StringRef(name), array, _json.GetAllocator());
+				_set_section->AddMember(rapidjson::StringRef(name), array, _doc_set->doc.GetAllocator());
 		}
 	};
 }
\ No newline at end of file
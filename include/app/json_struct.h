@@ -0,0 +1,219 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+// Описание полей структуры для сериализации в json (app::Json, app::JsonWriter,
+// app::Cbor, app::SimpleJson) и чтения из app::Json.
+// Поля описываются один раз, список разворачивается при компиляции.
+//
+// struct pos_struct { double lat; double lon; };
+// struct state_struct { uint32_t ms; pos_struct pos; };
+//
+// template <>
+// struct app::JsonStruct<pos_struct>
+// {
+//     static constexpr auto fields = std::make_tuple(
+//         app::json_field("lat", &pos_struct::lat, 7),
+//         app::json_field("lon", &pos_struct::lon, 7));
+// };
+//
+// template <>
+// struct app::JsonStruct<state_struct>
+// {
+//     static constexpr auto fields = std::make_tuple(
+//         app::json_field("ms", &state_struct::ms),
+//         app::json_field("pos", &state_struct::pos));
+// };
+//
+// app::json_set(json, state); // Запись в текущую секцию.
+// app::json_get(json, state); // Чтение из текущей секции.
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "json.h"
+#include "simple_json.h"
+
+
+namespace app
+{
+	// Поле структуры.
+	template <typename C, typename M>
+	struct JsonField
+	{
+		const char* name;
+		M C::* ptr;
+		int precision; // Количество знаков после запятой, < 0 - без округления.
+	};
+
+	template <typename C, typename M>
+	constexpr JsonField<C, M> json_field(const char* name, M C::* ptr, int precision = -1)
+	{
+		return {name, ptr, precision};
+	}
+
+	// Описание структуры: специализация со статическим полем fields (кортеж json_field).
+	template <typename T>
+	struct JsonStruct;
+
+	template <typename T, typename = void>
+	struct is_json_struct : std::false_type
+	{
+	};
+
+	template <typename T>
+	struct is_json_struct<T, std::void_t<decltype(JsonStruct<T>::fields)>> : std::true_type
+	{
+	};
+
+	template <typename TWriter, typename T>
+	void json_set(TWriter& writer, const T& obj);
+
+	template <typename T>
+	bool json_get(Json& json, T& obj);
+
+	namespace _
+	{
+		template <typename T>
+		struct is_json_arr : std::false_type
+		{
+		};
+
+		template <typename T>
+		struct is_json_arr<std::vector<T>> : std::true_type
+		{
+		};
+
+		template <typename T, size_t N>
+		struct is_json_arr<std::array<T, N>> : std::true_type
+		{
+		};
+
+		// Значение с округлением (double или массив double).
+		template <typename T>
+		struct is_json_round : std::is_same<T, double>
+		{
+		};
+
+		template <>
+		struct is_json_round<std::vector<double>> : std::true_type
+		{
+		};
+
+		template <size_t N>
+		struct is_json_round<std::array<double, N>> : std::true_type
+		{
+		};
+
+		// Запись поля (app::Json, app::JsonWriter, app::Cbor).
+		template <typename TWriter, typename C, typename M>
+		void json_set_field(TWriter& writer, const C& obj, const JsonField<C, M>& field)
+		{
+			const M& val = obj.*(field.ptr);
+			if constexpr (is_json_struct<M>::value)
+			{
+				writer.set_beg(field.name);
+				json_set(writer, val);
+				writer.set_end();
+			}
+			else if constexpr (std::is_same_v<M, float>)
+			{
+				if (field.precision >= 0)
+					writer.set(field.name, static_cast<double>(val), field.precision);
+				else
+					writer.set(field.name, val);
+			}
+			else if constexpr (is_json_round<M>::value)
+			{
+				if (field.precision >= 0)
+					writer.set(field.name, val, field.precision);
+				else
+					writer.set(field.name, val);
+			}
+			else
+				writer.set(field.name, val);
+		}
+
+		// Элемент массива (app::SimpleJson).
+		template <typename T>
+		void json_item(SimpleJson& writer, const T& val, int precision)
+		{
+			if constexpr (std::is_floating_point_v<T>)
+				writer.add_item(static_cast<double>(val), precision);
+			else if constexpr (std::is_same_v<T, std::string>)
+				writer.add_item(val.c_str());
+			else
+				writer.add_item(val);
+		}
+
+		// Запись поля (app::SimpleJson).
+		template <typename C, typename M>
+		void json_set_field(SimpleJson& writer, const C& obj, const JsonField<C, M>& field)
+		{
+			const M& val = obj.*(field.ptr);
+			if constexpr (is_json_struct<M>::value)
+			{
+				writer.add(field.name);
+				json_set(writer, val);
+				writer.end();
+			}
+			else if constexpr (is_json_arr<M>::value)
+			{
+				writer.add_arr(field.name);
+				for (const auto& item : val)
+					json_item(writer, item, field.precision);
+				writer.end();
+			}
+			else if constexpr (std::is_floating_point_v<M>)
+				writer.add(field.name, static_cast<double>(val), field.precision);
+			else
+				writer.add(field.name, val);
+		}
+
+		// Чтение поля.
+		template <typename C, typename M>
+		bool json_get_field(Json& json, C& obj, const JsonField<C, M>& field)
+		{
+			M& val = obj.*(field.ptr);
+			if constexpr (is_json_struct<M>::value)
+			{
+				bool ok = false;
+				if (json.get_beg(field.name))
+					ok = json_get(json, val);
+				json.get_end();
+				return ok;
+			}
+			else
+				return json.get(field.name, val);
+		}
+	}
+
+	// Запись структуры в текущую секцию.
+	template <typename TWriter, typename T>
+	void json_set(TWriter& writer, const T& obj)
+	{
+		static_assert(is_json_struct<T>::value, "app::json_set: app::JsonStruct<T> is not defined");
+		std::apply([&](const auto&... field)
+		{
+			(_::json_set_field(writer, obj, field), ...);
+		}, JsonStruct<T>::fields);
+	}
+
+	// Чтение структуры из текущей секции.
+	// Отсутствующие поля не изменяются. Возвращает true, если прочитано хотя бы одно поле.
+	template <typename T>
+	bool json_get(Json& json, T& obj)
+	{
+		static_assert(is_json_struct<T>::value, "app::json_get: app::JsonStruct<T> is not defined");
+		bool ok = false;
+		std::apply([&](const auto&... field)
+		{
+			((ok |= _::json_get_field(json, obj, field)), ...);
+		}, JsonStruct<T>::fields);
+		return ok;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,244 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#ifndef NDEBUG
+#define NDEBUG
+#endif
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include "math.h"
+
+
+namespace app
+{
+	// Потоковое формирование json без построения DOM.
+	// Интерфейс повторяет app::Json: секции задаются через set(path) (JSON Pointer),
+	// значения через set(name, val) и set(name, val, precision).
+	// Ключи и значения сразу пишутся в выходной буфер, поэтому секцию нужно заполнить
+	// целиком до перехода в другую: при выходе из секции она закрывается.
+	class JsonWriter
+	{
+	private:
+		rapidjson::StringBuffer _buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> _writer;
+		std::string _path; // Текущая секция ("" - корень, "/a/b").
+
+		void _key(const char* name)
+		{
+			_writer.Key(name, static_cast<rapidjson::SizeType>(std::strlen(name)));
+		}
+
+		// Запись значения.
+		template <typename T>
+		void _val(const T& val)
+		{
+			if constexpr (std::is_same_v<T, bool>)
+				_writer.Bool(val);
+			else if constexpr (std::is_floating_point_v<T>)
+				_writer.Double(static_cast<double>(val));
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+			{
+				if constexpr (sizeof(T) <= sizeof(int))
+					_writer.Int(static_cast<int>(val));
+				else
+					_writer.Int64(static_cast<int64_t>(val));
+			}
+			else if constexpr (std::is_integral_v<T>)
+			{
+				if constexpr (sizeof(T) <= sizeof(unsigned))
+					_writer.Uint(static_cast<unsigned>(val));
+				else
+					_writer.Uint64(static_cast<uint64_t>(val));
+			}
+			else
+				static_assert(std::is_arithmetic_v<T>, "app::JsonWriter: unsupported type");
+		}
+
+		void _val(const char* val)
+		{
+			_writer.String(val, static_cast<rapidjson::SizeType>(std::strlen(val)));
+		}
+
+		void _val(const std::string& val)
+		{
+			_writer.String(val.c_str(), static_cast<rapidjson::SizeType>(val.size()));
+		}
+
+		template <typename T>
+		void _val(const std::vector<T>& val)
+		{
+			_writer.StartArray();
+			for (size_t i = 0; i < val.size(); ++i)
+				_val(val[i]);
+			_writer.EndArray();
+		}
+
+		template <typename T, size_t N>
+		void _val(const std::array<T, N>& val)
+		{
+			_writer.StartArray();
+			for (size_t i = 0; i < N; ++i)
+				_val(val[i]);
+			_writer.EndArray();
+		}
+
+		void _round(double& val, const int p) const
+		{
+			val = math::round(val, p);
+		}
+
+		void _round(float& val, const int p) const
+		{
+			val = static_cast<float>(math::round(val, p));
+		}
+
+		template <size_t N>
+		void _round(std::array<double, N>& val, const int p) const
+		{
+			for (size_t i = 0; i < N; ++i)
+				val[i] = math::round(val[i], p);
+		}
+
+		void _round(std::vector<double>& val, const int p) const
+		{
+			size_t n = val.size();
+			for (size_t i = 0; i < n; ++i)
+				val[i] = math::round(val[i], p);
+		}
+
+		// Закрытие секций до уровня len.
+		void _close(size_t len)
+		{
+			while (_path.size() > len)
+			{
+				_path.resize(_path.rfind('/'));
+				_writer.EndObject();
+			}
+		}
+
+	public:
+		// decimal - количество знаков после запятой.
+		JsonWriter(int decimal = 9) :
+			_writer(_buffer)
+		{
+			set_decimal(decimal);
+		}
+
+		// decimal - количество знаков после запятой.
+		void set_decimal(int decimal)
+		{
+			_writer.SetMaxDecimalPlaces(decimal);
+		}
+
+		// Начало формирования json.
+		void beg()
+		{
+			_buffer.Clear();
+			_writer.Reset(_buffer);
+			_path.clear();
+			_writer.StartObject();
+		}
+
+		// Окончание формирования json.
+		const char* end(size_t& len)
+		{
+			_close(0);
+			_writer.EndObject();
+			len = _buffer.GetSize();
+			return _buffer.GetString();
+		}
+
+		// Окончание формирования json.
+		std::string end()
+		{
+			size_t len;
+			const char* data = end(len);
+			return std::string(data, len);
+		}
+
+		// Переход в секцию (JSON Pointer: "" - корень, "/a/b").
+		// Секции, из которых выходим, закрываются.
+		void set(const char* name)
+		{
+			// Общая часть текущей и новой секции (по границе токена).
+			size_t len = 0;
+			size_t i = 0;
+			const size_t size = _path.size();
+			while (i < size && name[i] != '\0' && _path[i] == name[i])
+			{
+				++i;
+				if (i == size || _path[i] == '/')
+				{
+					if (name[i] == '\0' || name[i] == '/')
+						len = i;
+				}
+			}
+			_close(len);
+			// Открытие новых секций.
+			const char* p = name + len;
+			while (*p == '/')
+			{
+				const char* beg = p + 1;
+				const char* e = std::strchr(beg, '/');
+				if (!e)
+					e = beg + std::strlen(beg);
+				_writer.Key(beg, static_cast<rapidjson::SizeType>(e - beg));
+				_writer.StartObject();
+				_path.append(p, e);
+				p = e;
+			}
+		}
+
+		// Вложенный объект в текущей секции. Возврат - set_end.
+		void set_beg(const char* name)
+		{
+			_key(name);
+			_writer.StartObject();
+			_path += '/';
+			_path += name;
+		}
+
+		// Закрытие вложенного объекта (set_beg) или текущей секции.
+		void set_end()
+		{
+			if (!_path.empty())
+				_close(_path.rfind('/'));
+		}
+
+		// Задание переменных.
+		template <typename T>
+		void set(const char* name, const T& val)
+		{
+			_key(name);
+			_val(val);
+		}
+
+		// Значение с округлением.
+		// precision = [0, 9], иначе ошибка.
+		template <typename T>
+		void set(const char* name, T val, int precision)
+		{
+			_round(val, precision);
+			set(name, val);
+		}
+
+		// Задание массива.
+		void set_arr(const char* name, const double* val, size_t size)
+		{
+			_key(name);
+			_writer.StartArray();
+			for (size_t i = 0; i < size; ++i)
+				_writer.Double(val[i]);
+			_writer.EndArray();
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+
+namespace app
+{
+	// Счётчики и показатели для наблюдения за работой программы (формат Prometheus).
+	// Метрики хранятся в массиве фиксированного размера и не удаляются.
+	// Обновление значений без блокировок из любого потока.
+	// Регистрация (counter, gauge, summary) обычно выполняется при запуске,
+	// полученную ссылку нужно сохранить и использовать при обновлении.
+	//
+	// auto& rx = app::metrics::counter("app_rx_bytes_total", "Received bytes");
+	// rx.inc(len);
+	// auto& upd = app::metrics::summary("app_module_update_seconds{module=\"gps\"}", "Module update time");
+	// upd.observe_ns(ns);
+	namespace metrics
+	{
+		enum class type_enum
+		{
+			COUNTER, // Только увеличивается.
+			GAUGE,   // Текущее значение.
+			SUMMARY  // Сумма и количество наблюдений (время в нс, выводится в секундах).
+		};
+
+		class Metric
+		{
+		private:
+			std::atomic<uint64_t> _val{0}; // Значение (GAUGE - биты double) или сумма (SUMMARY).
+			std::atomic<uint64_t> _count{0};
+
+		public:
+			char name[96] = {};  // Имя с метками: name{label="value"}.
+			const char* help = "";
+			type_enum type = type_enum::COUNTER;
+
+			// COUNTER.
+			void inc(uint64_t n = 1)
+			{
+				_val.fetch_add(n, std::memory_order_relaxed);
+			}
+
+			// GAUGE.
+			void set(double val)
+			{
+				uint64_t u;
+				std::memcpy(&u, &val, sizeof(u));
+				_val.store(u, std::memory_order_relaxed);
+			}
+
+			// SUMMARY.
+			void observe_ns(uint64_t ns)
+			{
+				_val.fetch_add(ns, std::memory_order_relaxed);
+				_count.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			uint64_t get() const
+			{
+				return _val.load(std::memory_order_relaxed);
+			}
+
+			double get_double() const
+			{
+				const uint64_t u = _val.load(std::memory_order_relaxed);
+				double val;
+				std::memcpy(&val, &u, sizeof(val));
+				return val;
+			}
+
+			uint64_t count() const
+			{
+				return _count.load(std::memory_order_relaxed);
+			}
+		};
+
+		namespace _
+		{
+			constexpr size_t max_size = 256;
+			std::array<Metric, max_size> list;
+			std::atomic<size_t> list_idx{0};  // Следующий свободный элемент.
+			std::atomic<size_t> list_size{0}; // Количество опубликованных элементов.
+			Metric dummy;                     // Если место закончилось.
+
+			// Имя без меток.
+			size_t family_len(const char* name)
+			{
+				const char* p = std::strchr(name, '{');
+				return p ? static_cast<size_t>(p - name) : std::strlen(name);
+			}
+
+			Metric& add(const char* name, const char* help, type_enum type)
+			{
+				// Уже зарегистрированная метрика.
+				const size_t size = list_size.load(std::memory_order_acquire);
+				for (size_t i = 0; i < size; ++i)
+				{
+					if (std::strcmp(list[i].name, name) == 0)
+						return list[i];
+				}
+				const size_t idx = list_idx.fetch_add(1, std::memory_order_relaxed);
+				if (idx >= max_size)
+					return dummy;
+				Metric& m = list[idx];
+				std::snprintf(m.name, sizeof(m.name), "%s", name);
+				m.help = help;
+				m.type = type;
+				// Публикация по порядку: ждём, пока будут опубликованы предыдущие элементы.
+				size_t expected = idx;
+				while (!list_size.compare_exchange_weak(expected, idx + 1, std::memory_order_release, std::memory_order_relaxed))
+					expected = idx;
+				return m;
+			}
+
+			void append_name(std::string& out, const char* name, const char* suffix)
+			{
+				const size_t len = family_len(name);
+				out.append(name, len);
+				out += suffix;
+				out += name + len;
+			}
+
+			bool same_family(const Metric& a, const Metric& b, size_t len)
+			{
+				return family_len(b.name) == len && std::strncmp(a.name, b.name, len) == 0;
+			}
+
+			void append_value(std::string& out, const Metric& m)
+			{
+				char buf[64];
+				if (m.type == type_enum::COUNTER)
+				{
+					out += m.name;
+					std::snprintf(buf, sizeof(buf), " %llu\n", static_cast<unsigned long long>(m.get()));
+					out += buf;
+				}
+				else if (m.type == type_enum::GAUGE)
+				{
+					out += m.name;
+					std::snprintf(buf, sizeof(buf), " %.9g\n", m.get_double());
+					out += buf;
+				}
+				else
+				{
+					append_name(out, m.name, "_sum");
+					std::snprintf(buf, sizeof(buf), " %.9f\n", 1e-9 * static_cast<double>(m.get()));
+					out += buf;
+					append_name(out, m.name, "_count");
+					std::snprintf(buf, sizeof(buf), " %llu\n", static_cast<unsigned long long>(m.count()));
+					out += buf;
+				}
+			}
+		}
+
+		Metric& counter(const char* name, const char* help = "")
+		{
+			return _::add(name, help, type_enum::COUNTER);
+		}
+
+		Metric& gauge(const char* name, const char* help = "")
+		{
+			return _::add(name, help, type_enum::GAUGE);
+		}
+
+		Metric& summary(const char* name, const char* help = "")
+		{
+			return _::add(name, help, type_enum::SUMMARY);
+		}
+
+		// Все метрики в текстовом формате Prometheus (version 0.0.4).
+		// Метрики одного семейства (имя без меток) выводятся вместе.
+		void text(std::string& out)
+		{
+			static const char* type_str[] = {"counter", "gauge", "summary"};
+			out.clear();
+			const size_t size = _::list_size.load(std::memory_order_acquire);
+			for (size_t i = 0; i < size; ++i)
+			{
+				const Metric& m = _::list[i];
+				const size_t len = _::family_len(m.name);
+				// Семейство уже выведено.
+				bool first = true;
+				for (size_t j = 0; j < i && first; ++j)
+					first = !_::same_family(m, _::list[j], len);
+				if (!first)
+					continue;
+				out += "# HELP ";
+				out.append(m.name, len);
+				out += ' ';
+				out += m.help;
+				out += "\n# TYPE ";
+				out.append(m.name, len);
+				out += ' ';
+				out += type_str[static_cast<int>(m.type)];
+				out += '\n';
+				for (size_t j = i; j < size; ++j)
+				{
+					if (_::same_family(m, _::list[j], len))
+						_::append_value(out, _::list[j]);
+				}
+			}
+		}
+
+		std::string text()
+		{
+			std::string out;
+			text(out);
+			return out;
+		}
+	}
+}
\ No newline at end of file
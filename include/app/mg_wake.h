@@ -0,0 +1,70 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <sys/socket.h>
+#include <unistd.h>
+#define MG_ENABLE_LOG 0
+#include <mongoose/mongoose.h>
+
+
+namespace app
+{
+	// Пробуждение mg_mgr_poll из другого потока.
+	// Один конец пары сокетов зарегистрирован в менеджере mongoose (mg_wrapfd),
+	// запись в другой конец завершает ожидание mg_mgr_poll.
+	class MgWake
+	{
+	private:
+		int _fd = -1; // Конец для записи (второй закрывает mongoose в mg_mgr_free).
+
+		static void _handler(mg_connection* c, int ev, void*, void*)
+		{
+			if (ev == MG_EV_READ)
+				c->recv.len = 0;
+		}
+
+	public:
+		~MgWake()
+		{
+			end();
+		}
+
+		bool beg(mg_mgr* mgr)
+		{
+			end();
+			int fd[2];
+			if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fd) != 0)
+				return false;
+			if (!mg_wrapfd(mgr, fd[0], MgWake::_handler, nullptr))
+			{
+				close(fd[0]);
+				close(fd[1]);
+				return false;
+			}
+			_fd = fd[1];
+			return true;
+		}
+
+		// Вызывается после mg_mgr_free.
+		void end()
+		{
+			if (_fd < 0)
+				return;
+			close(_fd);
+			_fd = -1;
+		}
+
+		// Пробуждение (можно вызывать из любого потока).
+		// Если буфер сокета заполнен, то пробуждение уже запрошено.
+		void wake()
+		{
+			if (_fd < 0)
+				return;
+			const char c = 0;
+			send(_fd, &c, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+		}
+	};
+}
\ No newline at end of file
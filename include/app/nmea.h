@@ -6,8 +6,8 @@
 
 #include <array>
 #include <cstdint>
-#include <cstdlib>
 #include <cstring>
+#include "num.h"
 
 
 namespace app
@@ -193,18 +193,33 @@ namespace app
 			return &_hex[16];
 		}
 
+		// Разбор числового параметра с проверкой ошибок.
+		// Значение val изменяется только в случае успеха.
+		template <typename T>
+		num::err get(uint16_t idx, T& val) const
+		{
+			if (idx >= _idx_par)
+				return num::err::EMPTY;
+			const char* beg = &_data[_param[idx]];
+			const char* end = (idx + 1 < _idx_par) ? &_data[_param[idx + 1] - 1] : beg + std::strlen(beg);
+			return num::parse(beg, end, val);
+		}
+
+		// Разбор начала параметра как atof/atoi ("12.5" -> 12), 0 если числа нет.
 		double get_double(uint16_t idx) const
 		{
-			if (idx < _idx_par)
-				return std::atof(&_data[_param[idx]]);
-			return 0.0;
+			if (idx >= _idx_par)
+				return 0.0;
+			const char* beg = &_data[_param[idx]];
+			return num::lead(beg, beg + std::strlen(beg), 0.0);
 		}
 
 		int get_int(uint16_t idx) const
 		{
-			if (idx < _idx_par)
-				return std::atoi(&_data[_param[idx]]);
-			return 0;
+			if (idx >= _idx_par)
+				return 0;
+			const char* beg = &_data[_param[idx]];
+			return num::lead(beg, beg + std::strlen(beg), 0);
 		}
 
 		uint16_t get_uint8(uint16_t idx) const
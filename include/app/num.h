@@ -0,0 +1,143 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+
+namespace app
+{
+	// Разбор чисел из текста без выделения памяти и без учёта локали (std::from_chars).
+	namespace num
+	{
+		// Результат разбора.
+		enum class err
+		{
+			OK,       // Успех.
+			EMPTY,    // Пустая строка.
+			INVALID,  // Не число.
+			RANGE,    // Значение не помещается в тип.
+			TRAILING  // Лишние символы после числа.
+		};
+
+		const char* err_str(err e)
+		{
+			switch (e)
+			{
+				case err::OK:
+					return "ok";
+				case err::EMPTY:
+					return "empty";
+				case err::INVALID:
+					return "invalid";
+				case err::RANGE:
+					return "out of range";
+				case err::TRAILING:
+					return "trailing characters";
+			}
+			return "unknown";
+		}
+
+		namespace _
+		{
+			err res(const std::from_chars_result& r, const char* end)
+			{
+				if (r.ec == std::errc::invalid_argument)
+					return err::INVALID;
+				if (r.ec == std::errc::result_out_of_range)
+					return err::RANGE;
+				if (r.ptr != end)
+					return err::TRAILING;
+				return err::OK;
+			}
+		}
+
+		// Разбор числа из диапазона [beg, end).
+		// Целые числа: десятичные или шестнадцатеричные (0x).
+		// Значение val изменяется только в случае успеха.
+		template <typename T>
+		err parse(const char* beg, const char* end, T& val)
+		{
+			static_assert(std::is_arithmetic_v<T>, "app::num::parse: arithmetic type expected");
+			if (beg == end)
+				return err::EMPTY;
+			// from_chars не принимает знак +.
+			if (*beg == '+')
+			{
+				++beg;
+				if (beg == end || *beg == '-')
+					return err::INVALID;
+			}
+			T v;
+			std::from_chars_result r;
+			if constexpr (std::is_same_v<T, bool>)
+			{
+				int i = 0;
+				r = std::from_chars(beg, end, i);
+				v = (i == 1);
+			}
+			else if constexpr (std::is_floating_point_v<T>)
+				r = std::from_chars(beg, end, v);
+			else if (end - beg > 2 && beg[0] == '0' && (beg[1] == 'x' || beg[1] == 'X'))
+				r = std::from_chars(beg + 2, end, v, 16);
+			else
+				r = std::from_chars(beg, end, v);
+			const err e = _::res(r, end);
+			if (e == err::OK)
+				val = v;
+			return e;
+		}
+
+		// Разбор строки, заканчивающейся \0.
+		template <typename T>
+		err parse(const char* str, T& val)
+		{
+			return parse(str, str + std::strlen(str), val);
+		}
+
+		// Разбор начала строки (как atof/atoi): пробелы в начале пропускаются, символы после числа не учитываются.
+		// Целые числа только десятичные. Если числа нет, то возвращается def.
+		template <typename T>
+		T lead(const char* beg, const char* end, const T& def)
+		{
+			static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "app::num::lead: arithmetic type expected");
+			while (beg != end && (*beg == ' ' || *beg == '\t'))
+				++beg;
+			if (beg != end && *beg == '+')
+			{
+				++beg;
+				if (beg != end && *beg == '-')
+					return def;
+			}
+			T v;
+			const std::from_chars_result r = std::from_chars(beg, end, v);
+			if (r.ec != std::errc())
+				return def;
+			return v;
+		}
+
+		// Разбор с значением по умолчанию.
+		template <typename T>
+		T get(const char* beg, const char* end, const T& def)
+		{
+			T val = def;
+			parse(beg, end, val);
+			return val;
+		}
+
+		template <typename T>
+		T get(const char* str, const T& def)
+		{
+			T val = def;
+			parse(str, val);
+			return val;
+		}
+	}
+}
\ No newline at end of file
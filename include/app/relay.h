@@ -0,0 +1,273 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#define MG_ENABLE_LOG 0
+#include <mongoose/mongoose.h>
+#include "config.h"
+#include "metrics.h"
+#include "mg_wake.h"
+#include "thread.h"
+
+
+namespace app
+{
+	// Ретрансляция потока байт (GNSS, AIS, RTCM) всем TCP клиентам.
+	// Данные один раз записываются в кольцевой буфер, каждый клиент читает его со своей позиции.
+	// Данные пишутся в сокеты напрямую из буфера (без очереди mongoose).
+	// Если клиент отстал больше чем на lag_limit байт, то его позиция переносится на конец данных.
+	// Запись и отправка не блокируют друг друга: поток отправки читает только опубликованные данные,
+	// а клиент, данные которого были перезаписаны во время отправки, отключается.
+	// Методы записи вызываются из одного потока.
+	//
+	// relay.write_from([&](uint8_t* buf, size_t size) { return serial.read_data(buf, size); });
+	// relay.write(tcp_client.data(), tcp_client.data_size());
+	class TCPRelay : public Thread
+	{
+	public:
+		// Статистика клиента.
+		struct client_stat
+		{
+			unsigned long id;
+			uint64_t lag;  // Неотправленные данные (байт).
+			uint64_t sent; // Отправлено (байт).
+			uint64_t skip; // Пропущено (байт).
+		};
+
+	private:
+		struct client_struct
+		{
+			mg_connection* conn;
+			uint64_t pos;  // Позиция в потоке данных.
+			uint64_t sent;
+			uint64_t skip;
+		};
+
+		bool _ok = false;
+		mg_mgr _mgr;
+		int _min_ms = 5;
+		MgWake _wake; // Немедленная отправка данных без ожидания mg_mgr_poll.
+		std::vector<uint8_t> _buf; // Кольцевой буфер.
+		size_t _mask = 0;
+		std::atomic<uint64_t> _head{0}; // Количество записанных байт (позиция конца данных).
+		uint64_t _lag_limit = 0;   // Максимальное отставание клиента (байт).
+		std::vector<client_struct> _clients; // Используется потоком сервера.
+		std::vector<client_stat> _stat;      // Статистика клиентов (копия для чтения из других потоков).
+		std::mutex _mutex;                   // Только для _stat.
+		metrics::Metric& _m_send = metrics::counter("relay_send_bytes_total", "Relay bytes sent");
+		metrics::Metric& _m_skip = metrics::counter("relay_skip_bytes_total", "Relay bytes skipped by slow clients");
+		metrics::Metric& _m_clients = metrics::gauge("relay_clients", "Connected relay clients");
+
+		static void _handler(mg_connection* c, int ev, void*, void* fn_data)
+		{
+			TCPRelay* relay = (TCPRelay*)fn_data;
+			if (ev == MG_EV_ACCEPT)
+				relay->_add(c);
+			else if (ev == MG_EV_CLOSE)
+				relay->_del(c);
+			else if (ev == MG_EV_READ)
+				c->recv.len = 0; // Данные от клиентов не используются.
+		}
+
+		// Новый клиент получает данные с текущей позиции.
+		void _add(mg_connection* c)
+		{
+			_clients.push_back({c, _head.load(std::memory_order_acquire), 0, 0});
+			_m_clients.set(static_cast<double>(_clients.size()));
+			std::cout << "relay clients: " << _clients.size() << std::endl;
+		}
+
+		void _del(mg_connection* c)
+		{
+			const size_t len = _clients.size();
+			size_t i = 0;
+			for (; i < len; ++i)
+			{
+				if (_clients[i].conn == c)
+					break;
+			}
+			if (i >= len)
+				return;
+			for (size_t j = i + 1; j < len; ++j)
+				_clients[j - 1] = _clients[j];
+			_clients.resize(len - 1);
+			_m_clients.set(static_cast<double>(_clients.size()));
+			std::cout << "relay clients: " << _clients.size() << std::endl;
+		}
+
+		// Отправка клиенту данных с его позиции до head (без блокировки записи).
+		void _send(client_struct& client, uint64_t head)
+		{
+			mg_connection* c = client.conn;
+			if (c->is_closing || c->is_draining)
+				return;
+			const uint64_t lag = head - client.pos;
+			if (lag == 0)
+				return;
+			if (lag > _lag_limit)
+			{
+				client.skip += lag;
+				client.pos = head;
+				_m_skip.inc(lag);
+				return;
+			}
+			// Данные в буфере могут быть разделены концом буфера.
+			const size_t pos = static_cast<size_t>(client.pos) & _mask;
+			const size_t len = static_cast<size_t>(lag);
+			const size_t len_1 = std::min(len, _buf.size() - pos);
+			iovec iov[2];
+			iov[0].iov_base = &_buf[pos];
+			iov[0].iov_len = len_1;
+			iov[1].iov_base = _buf.data();
+			iov[1].iov_len = len - len_1;
+			msghdr msg = {};
+			msg.msg_iov = iov;
+			msg.msg_iovlen = len_1 < len ? 2 : 1;
+			const ssize_t res = sendmsg(static_cast<int>(reinterpret_cast<size_t>(c->fd)), &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+			// Во время отправки данные могли быть перезаписаны (запись обогнала клиента на размер буфера).
+			if (res > 0 && _head.load(std::memory_order_acquire) - client.pos > _buf.size())
+			{
+				std::cout << "relay client " << c->id << " closed: data overwritten while sending" << std::endl;
+				c->is_closing = 1;
+				return;
+			}
+			if (res > 0)
+			{
+				client.pos += static_cast<uint64_t>(res);
+				client.sent += static_cast<uint64_t>(res);
+				_m_send.inc(static_cast<uint64_t>(res));
+			}
+			else if (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				c->is_closing = 1;
+		}
+
+		// Обработка в отдельном потоке.
+		void _thread_run()
+		{
+			mg_mgr_poll(&_mgr, _min_ms);
+			//
+			if (_clients.empty() && _stat.empty())
+				return;
+			const uint64_t head = _head.load(std::memory_order_acquire);
+			for (auto& client : _clients)
+				_send(client, head);
+			std::lock_guard<std::mutex> guard(_mutex);
+			_stat.resize(_clients.size());
+			for (size_t i = 0; i < _clients.size(); ++i)
+			{
+				const auto& client = _clients[i];
+				_stat[i] = {client.conn->id, head - client.pos, client.sent, client.skip};
+			}
+		}
+
+	public:
+		void end()
+		{
+			if (!_ok)
+				return;
+			thread_end();
+			mg_mgr_free(&_mgr);
+			_wake.end();
+			_clients.clear();
+			_ok = false;
+		}
+
+		bool beg(const Config& cfg)
+		{
+			end();
+			_min_ms = cfg.get("min_ms", 5);
+			int port = cfg.get("port", 8090, 1, 65535);
+			// Размер кольцевого буфера (округляется вверх до степени двойки) и допустимое отставание клиента.
+			const size_t buf_size = cfg.get<size_t>("buf_size", 1048576, 1024, 1073741824);
+			size_t size = 1;
+			while (size < buf_size)
+				size <<= 1;
+			_buf.assign(size, 0);
+			_mask = size - 1;
+			_head = 0;
+			// Не больше половины буфера: запас на запись во время отправки.
+			_lag_limit = std::min<uint64_t>(cfg.get<uint64_t>("lag_limit", size / 2), size / 2);
+			std::string url = "tcp://0.0.0.0:" + std::to_string(port);
+			mg_mgr_init(&_mgr);
+			if (!_wake.beg(&_mgr))
+				std::cout << "wakeup not available" << std::endl;
+			mg_listen(&_mgr, url.c_str(), TCPRelay::_handler, this);
+			thread_run();
+			_ok = true;
+			return true;
+		}
+
+		~TCPRelay()
+		{
+			end();
+		}
+
+		// Запись данных (единственное копирование для всех клиентов).
+		void write(const uint8_t* data, size_t len)
+		{
+			if (len == 0 || _buf.empty())
+				return;
+			uint64_t head = _head.load(std::memory_order_relaxed);
+			// Сохраняются только последние данные, которые помещаются в буфер.
+			if (len > _buf.size())
+			{
+				head += len - _buf.size();
+				data += len - _buf.size();
+				len = _buf.size();
+			}
+			const size_t pos = static_cast<size_t>(head) & _mask;
+			const size_t len_1 = std::min(len, _buf.size() - pos);
+			std::memcpy(&_buf[pos], data, len_1);
+			std::memcpy(_buf.data(), data + len_1, len - len_1);
+			// Данные публикуются после записи в буфер.
+			_head.store(head + len, std::memory_order_release);
+			_wake.wake();
+		}
+
+		void write(const std::string& data)
+		{
+			write(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+		}
+
+		// Чтение из источника сразу в буфер (без промежуточного копирования).
+		// read(buf, size) - записывает в buf не больше size байт и возвращает их количество.
+		template <typename TRead>
+		size_t write_from(TRead&& read)
+		{
+			if (_buf.empty())
+				return 0;
+			const uint64_t head = _head.load(std::memory_order_relaxed);
+			const size_t pos = static_cast<size_t>(head) & _mask;
+			const size_t len = std::min(read(&_buf[pos], _buf.size() - pos), _buf.size() - pos);
+			if (len == 0)
+				return 0;
+			_head.store(head + len, std::memory_order_release);
+			_wake.wake();
+			return len;
+		}
+
+		// Количество записанных байт.
+		uint64_t size() const
+		{
+			return _head.load(std::memory_order_acquire);
+		}
+
+		// Статистика клиентов на момент последней отправки.
+		std::vector<client_stat> clients()
+		{
+			std::lock_guard<std::mutex> guard(_mutex);
+			return _stat;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,215 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "config.h"
+#include "print.h"
+
+
+namespace app
+{
+	// Публикация состояния в разделяемой памяти (/dev/shm) для процессов на том же компьютере.
+	// Запись и чтение без системных вызовов: состояние защищено счётчиком версии (seqlock).
+	// Один процесс записывает (ShmPub), любое количество процессов читает (ShmSub).
+	// Для старых версий glibc (< 2.34) нужна библиотека rt (-lrt).
+	//
+	// app::ShmPub<State> pub;            app::ShmSub<State> sub;
+	// pub.beg("/app_state");             sub.beg("/app_state");
+	// pub.set(state);                    if (sub.get(state)) ...
+	namespace _
+	{
+		constexpr uint64_t shm_magic = 0x31534D4853505041ULL; // "APPSHMS1".
+
+		template <typename T>
+		struct shm_struct
+		{
+			uint64_t magic;
+			uint64_t size;              // sizeof(T).
+			std::atomic<uint64_t> seq;  // Версия: нечётная - идёт запись.
+			T data;
+		};
+	}
+
+	template <typename T>
+	class ShmPub
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "app::ShmPub: T must be trivially copyable");
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "app::ShmPub: lock-free atomic required");
+
+	private:
+		_::shm_struct<T>* _shm = nullptr;
+		std::string _name;
+		bool _unlink = true; // Удаление объекта при завершении.
+
+	public:
+		~ShmPub()
+		{
+			end();
+		}
+
+		void end()
+		{
+			if (!_shm)
+				return;
+			munmap(_shm, sizeof(_::shm_struct<T>));
+			_shm = nullptr;
+			if (_unlink)
+				shm_unlink(_name.c_str());
+		}
+
+		// name - имя объекта ("/name").
+		// unlink - удалить объект при завершении (читатели сохраняют доступ к отображённой памяти).
+		bool beg(const std::string& name, bool unlink = true)
+		{
+			end();
+			_name = name;
+			_unlink = unlink;
+			const int fd = shm_open(_name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+			if (fd < 0)
+				return print_errno("ShmPub shm_open");
+			if (ftruncate(fd, sizeof(_::shm_struct<T>)) != 0)
+			{
+				close(fd);
+				return print_errno("ShmPub ftruncate");
+			}
+			void* ptr = mmap(nullptr, sizeof(_::shm_struct<T>), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (ptr == MAP_FAILED)
+				return print_errno("ShmPub mmap");
+			_shm = static_cast<_::shm_struct<T>*>(ptr);
+			// Версия 0 - данных ещё нет.
+			_shm->seq.store(0, std::memory_order_relaxed);
+			_shm->size = sizeof(T);
+			std::atomic_thread_fence(std::memory_order_release);
+			_shm->magic = _::shm_magic;
+			return true;
+		}
+
+		bool beg(const Config& cfg)
+		{
+			return beg(cfg.get<std::string>("name", "/app_state"), cfg.get("unlink", true));
+		}
+
+		// Публикация состояния.
+		void set(const T& data)
+		{
+			if (!_shm)
+				return;
+			const uint64_t seq = _shm->seq.load(std::memory_order_relaxed);
+			_shm->seq.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			std::memcpy(&_shm->data, &data, sizeof(T));
+			_shm->seq.store(seq + 2, std::memory_order_release);
+		}
+
+		// Количество публикаций.
+		uint64_t version() const
+		{
+			return _shm ? _shm->seq.load(std::memory_order_relaxed) / 2 : 0;
+		}
+	};
+
+	template <typename T>
+	class ShmSub
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "app::ShmSub: T must be trivially copyable");
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "app::ShmSub: lock-free atomic required");
+
+	private:
+		const _::shm_struct<T>* _shm = nullptr;
+		uint64_t _seq = 0; // Версия последнего прочитанного состояния.
+
+	public:
+		~ShmSub()
+		{
+			end();
+		}
+
+		void end()
+		{
+			if (!_shm)
+				return;
+			munmap(const_cast<_::shm_struct<T>*>(_shm), sizeof(_::shm_struct<T>));
+			_shm = nullptr;
+			_seq = 0;
+		}
+
+		// Подключение к объекту, созданному ShmPub (размер T должен совпадать).
+		bool beg(const std::string& name)
+		{
+			end();
+			const int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+			if (fd < 0)
+				return print_errno("ShmSub shm_open");
+			struct stat st;
+			if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(_::shm_struct<T>))
+			{
+				close(fd);
+				return print_error("ShmSub size mismatch: ", name.c_str());
+			}
+			void* ptr = mmap(nullptr, sizeof(_::shm_struct<T>), PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if (ptr == MAP_FAILED)
+				return print_errno("ShmSub mmap");
+			_shm = static_cast<const _::shm_struct<T>*>(ptr);
+			if (_shm->magic != _::shm_magic || _shm->size != sizeof(T))
+			{
+				end();
+				return print_error("ShmSub not compatible: ", name.c_str());
+			}
+			return true;
+		}
+
+		bool beg(const Config& cfg)
+		{
+			return beg(cfg.get<std::string>("name", "/app_state"));
+		}
+
+		// Есть ли новое состояние после последнего get.
+		bool is_new() const
+		{
+			return _shm && _shm->seq.load(std::memory_order_acquire) > _seq;
+		}
+
+		// Чтение согласованного состояния.
+		// Возвращает false, если данных ещё нет или запись не завершилась за retry попыток.
+		bool get(T& data, size_t retry = 1000)
+		{
+			if (!_shm)
+				return false;
+			for (size_t i = 0; i < retry; ++i)
+			{
+				const uint64_t seq = _shm->seq.load(std::memory_order_acquire);
+				if (seq == 0)
+					return false;
+				if (seq & 1)
+					continue;
+				std::memcpy(&data, &_shm->data, sizeof(T));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (_shm->seq.load(std::memory_order_relaxed) == seq)
+				{
+					_seq = seq;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Номер прочитанной публикации.
+		uint64_t version() const
+		{
+			return _seq / 2;
+		}
+	};
+}
\ No newline at end of file
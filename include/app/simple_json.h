@@ -4,90 +4,269 @@
 
 #pragma once
 
-#include <array>
-#include <cstdio>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <string>
+#include <system_error>
+#include <type_traits>
 #include <vector>
 
 
 namespace app
 {
-	// Кавычки (") в строках не экранируются.
+	// Простое формирование json в растущем буфере.
+	// Числа форматируются через std::to_chars, строки экранируются.
+	// add(name) и add_arr(name) открывают объект и массив, end() закрывает последний открытый.
 	class SimpleJson
 	{
 	private:
 		std::vector<char> _buf;
-		int _buf_size = 2048;
-		int _buf_idx = 0;
+		size_t _buf_idx = 0;
+		std::vector<char> _close; // Закрывающие символы открытых объектов и массивов.
+
+		// Свободное место не меньше n байт.
+		char* _reserve(size_t n)
+		{
+			if (_buf_idx + n > _buf.size())
+				_buf.resize(std::max(_buf.size() * 2, _buf_idx + n));
+			return &_buf[_buf_idx];
+		}
+
+		void _char(char c)
+		{
+			*_reserve(1) = c;
+			++_buf_idx;
+		}
 
 		void _comma()
 		{
-			if (_buf[_buf_idx - 1] == '{')
+			if (_buf_idx == 0)
 				return;
-			_buf[_buf_idx] = ',';
-			++_buf_idx;
+			const char c = _buf[_buf_idx - 1];
+			if (c == '{' || c == '[')
+				return;
+			_char(',');
+		}
+
+		// Строка в кавычках с экранированием.
+		void _str(const char* str)
+		{
+			static const char* hex = "0123456789abcdef";
+			const size_t len = std::strlen(str);
+			// Худший случай: каждый символ как \u00XX.
+			char* p = _reserve(len * 6 + 2);
+			char* const beg = p;
+			*p++ = '"';
+			for (size_t i = 0; i < len; ++i)
+			{
+				const unsigned char c = static_cast<unsigned char>(str[i]);
+				if (c >= 0x20 && c != '"' && c != '\\')
+				{
+					*p++ = static_cast<char>(c);
+					continue;
+				}
+				*p++ = '\\';
+				switch (c)
+				{
+					case '"':
+						*p++ = '"';
+						break;
+					case '\\':
+						*p++ = '\\';
+						break;
+					case '\n':
+						*p++ = 'n';
+						break;
+					case '\r':
+						*p++ = 'r';
+						break;
+					case '\t':
+						*p++ = 't';
+						break;
+					case '\b':
+						*p++ = 'b';
+						break;
+					case '\f':
+						*p++ = 'f';
+						break;
+					default:
+						*p++ = 'u';
+						*p++ = '0';
+						*p++ = '0';
+						*p++ = hex[c >> 4];
+						*p++ = hex[c & 0xF];
+						break;
+				}
+			}
+			*p++ = '"';
+			_buf_idx += static_cast<size_t>(p - beg);
+		}
+
+		void _name(const char* name)
+		{
+			_comma();
+			_str(name);
+			_char(':');
+		}
+
+		// Число.
+		// precision < 0 - кратчайшая запись без потери точности.
+		void _double(double val, int precision)
+		{
+			// В json нет nan и inf.
+			if (!std::isfinite(val))
+			{
+				std::memcpy(_reserve(4), "null", 4);
+				_buf_idx += 4;
+				return;
+			}
+			size_t n = 32;
+			while (true)
+			{
+				char* p = _reserve(n);
+				std::to_chars_result r;
+				if (precision < 0)
+					r = std::to_chars(p, p + n, val);
+				else
+					r = std::to_chars(p, p + n, val, std::chars_format::fixed, precision);
+				if (r.ec == std::errc())
+				{
+					_buf_idx += static_cast<size_t>(r.ptr - p);
+					return;
+				}
+				n *= 2;
+			}
+		}
+
+		void _bool(bool val)
+		{
+			if (val)
+			{
+				std::memcpy(_reserve(4), "true", 4);
+				_buf_idx += 4;
+			}
+			else
+			{
+				std::memcpy(_reserve(5), "false", 5);
+				_buf_idx += 5;
+			}
+		}
+
+		template <typename T>
+		void _int(T val)
+		{
+			char* p = _reserve(24);
+			const auto r = std::to_chars(p, p + 24, val);
+			_buf_idx += static_cast<size_t>(r.ptr - p);
 		}
 
 	public:
-		SimpleJson()
+		explicit SimpleJson(size_t size = 2048)
 		{
-			_buf.resize(_buf_size);
+			_buf.resize(size);
 		}
 
+		// Начало формирования json.
 		void add()
 		{
-			_buf[_buf_idx] = '{';
-			_buf_idx = 1;
+			_buf_idx = 0;
+			_close.clear();
+			_char('{');
+			_close.push_back('}');
 		}
 
+		// Вложенный объект.
 		void add(const char* name)
+		{
+			_name(name);
+			_char('{');
+			_close.push_back('}');
+		}
+
+		// Вложенный массив. Элементы задаются через add_item.
+		void add_arr(const char* name)
+		{
+			_name(name);
+			_char('[');
+			_close.push_back(']');
+		}
+
+		void add(const char* name, bool val)
+		{
+			_name(name);
+			_bool(val);
+		}
+
+		template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+		void add(const char* name, T val)
+		{
+			_name(name);
+			_int(val);
+		}
+
+		// precision - количество знаков после запятой, < 0 - кратчайшая запись.
+		void add(const char* name, double val, int precision = 3)
+		{
+			_name(name);
+			_double(val, precision);
+		}
+
+		void add(const char* name, const char* val)
+		{
+			_name(name);
+			_str(val);
+		}
+
+		void add(const char* name, const std::string& val)
+		{
+			add(name, val.c_str());
+		}
+
+		// Элемент массива.
+		void add_item(bool val)
 		{
 			_comma();
-			_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":{", name);
+			_bool(val);
 		}
 
-		void add(const char* name, int val)
+		template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+		void add_item(T val)
 		{
 			_comma();
-			_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%d", name, val);
+			_int(val);
 		}
 
-		void add(const char* name, double val, int precision = 3)
+		void add_item(double val, int precision = 3)
 		{
 			_comma();
-			switch (precision)
-			{
-				case 1:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%.1f", name, val);
-					break;
-				case 2:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%.2f", name, val);
-					break;
-				case 3:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%.3f", name, val);
-					break;
-				case 4:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%.4f", name, val);
-					break;
-				case 5:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%.5f", name, val);
-					break;
-				case 6:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%.6f", name, val);
-					break;
-				case 7:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%.7f", name, val);
-					break;
-				default:
-					_buf_idx += sprintf(&_buf[_buf_idx], "\"%s\":%f", name, val);
-					break;
-			}
+			_double(val, precision);
+		}
+
+		void add_item(const char* val)
+		{
+			_comma();
+			_str(val);
 		}
 
+		// Закрытие последнего открытого объекта или массива.
 		void end()
 		{
-			_buf[_buf_idx] = '}';
-			++_buf_idx;
+			if (_close.empty())
+				return;
+			_char(_close.back());
+			_close.pop_back();
+		}
+
+		const char* data() const
+		{
+			return _buf.data();
+		}
+
+		size_t size() const
+		{
+			return _buf_idx;
 		}
 
 		std::string str()
@@ -0,0 +1,64 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+namespace app
+{
+	// Очередь без блокировок для одного потока записи и одного потока чтения.
+	// Размер округляется вверх до степени двойки.
+	template <typename T>
+	class SPSCQueue
+	{
+	private:
+		std::vector<T> _buf;
+		size_t _mask = 0;
+		alignas(64) std::atomic<size_t> _head{0}; // Следующий элемент для чтения.
+		alignas(64) std::atomic<size_t> _tail{0}; // Следующий элемент для записи.
+
+	public:
+		SPSCQueue(size_t size = 64)
+		{
+			size_t n = 1;
+			while (n < size)
+				n <<= 1;
+			_buf.resize(n);
+			_mask = n - 1;
+		}
+
+		// Запись (поток записи). Если очередь заполнена, возвращает false.
+		bool push(T val)
+		{
+			const size_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail - _head.load(std::memory_order_acquire) > _mask)
+				return false;
+			_buf[tail & _mask] = std::move(val);
+			_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Чтение (поток чтения). Если очередь пуста, возвращает false.
+		bool pop(T& val)
+		{
+			const size_t head = _head.load(std::memory_order_relaxed);
+			if (head == _tail.load(std::memory_order_acquire))
+				return false;
+			val = std::move(_buf[head & _mask]);
+			_buf[head & _mask] = T();
+			_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Количество элементов (приблизительно, если очередь используется).
+		size_t size() const
+		{
+			return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+		}
+	};
+}
\ No newline at end of file
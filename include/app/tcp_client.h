@@ -4,46 +4,148 @@
 
 #pragma once
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <array>
+#include <cerrno>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <random>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
+#include "config.h"
 #include "print.h"
 #include "time.h"
 
 
 namespace app
 {
+	// TCP клиент.
+	// Подключение выполняется без блокировки: update() начинает подключение и проверяет его завершение.
+	// Повторные попытки с экспоненциально растущей задержкой (reconnect_ms .. reconnect_max_ms) и случайным разбросом.
 	class TCPClient
 	{
+	public:
+		enum class state_enum
+		{
+			DISCONNECTED, // Нет подключения (ожидание следующей попытки).
+			CONNECTING,   // Подключение начато.
+			CONNECTED     // Подключено.
+		};
+
 	private:
 		int _sock = -1;
 		sockaddr_in _addr;             // Адрес сервера.
-		uint32_t _reconnect_ms = 0;    // Время переподключения.
-		uint32_t _last_connect_ms = 0; // Время попытки подключения.
+		state_enum _state = state_enum::DISCONNECTED;
+		uint32_t _reconnect_ms = 0;    // Задержка переподключения (0 - без переподключения).
+		uint32_t _reconnect_max_ms = 0; // Максимальная задержка переподключения.
+		uint32_t _connect_timeout_ms = 3000; // Максимальное время подключения.
+		uint32_t _stable_ms = 10000;   // Подключение считается устойчивым (сброс задержки), если не разорвано за это время.
+		uint32_t _fail = 0;            // Количество неудачных попыток (или разрывов) подряд.
+		uint64_t _connect_ns = 0;      // Время начала подключения.
+		uint64_t _next_ns = 0;         // Время следующей попытки подключения.
+		std::minstd_rand _rand;
 		std::vector<uint8_t> _buf;     // Буфер данных.
 		size_t _data_size = 0;         // Количество прочитанных данных.
 
-		// Подключение к заданному серверу.
+		// Закрытие подключения.
+		void _close()
+		{
+			if (_sock >= 0)
+			{
+				close(_sock);
+				_sock = -1;
+			}
+			_state = state_enum::DISCONNECTED;
+			_data_size = 0;
+		}
+
+		// Неудачная попытка: закрытие сокета и время следующей попытки.
+		// Задержка удваивается до reconnect_max_ms, фактическая задержка случайна в [d / 2, d].
+		bool _fail_connect(const char* msg)
+		{
+			if (msg)
+				print_errno(msg);
+			_close();
+			if (_fail < 31)
+				++_fail;
+			uint64_t delay = static_cast<uint64_t>(_reconnect_ms) << (_fail - 1);
+			if (delay > _reconnect_max_ms)
+				delay = _reconnect_max_ms;
+			if (delay > 1)
+				delay = delay / 2 + _rand() % (delay / 2 + 1);
+			_next_ns = time::ns() + delay * 1000000ULL;
+			return false;
+		}
+
+		// Начало подключения к заданному серверу (без ожидания).
 		bool _connect()
 		{
-			_last_connect_ms = time::ms() + _reconnect_ms;
-			_sock = socket(AF_INET, SOCK_STREAM, 0);
+			_sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
 			if (_sock < 0)
-				return print_errno("TCPClient socket");
+				return _fail_connect("TCPClient socket");
+			_connect_ns = time::ns();
 			if (connect(_sock, (sockaddr*)&_addr, sizeof(_addr)) != 0)
 			{
-				close(_sock);
-				_sock = -1;
-				return print_errno("TCPClient connect");
+				if (errno != EINPROGRESS)
+					return _fail_connect("TCPClient connect");
+				_state = state_enum::CONNECTING;
+				return _check_connect(0);
+			}
+			return _connected();
+		}
+
+		// Проверка завершения подключения.
+		// wait_ms - время ожидания.
+		bool _check_connect(int wait_ms)
+		{
+			pollfd pfd;
+			pfd.fd = _sock;
+			pfd.events = POLLOUT;
+			pfd.revents = 0;
+			const int res = poll(&pfd, 1, wait_ms);
+			if (res < 0)
+				return errno == EINTR ? false : _fail_connect("TCPClient poll");
+			if (res == 0)
+			{
+				if (time::ns() - _connect_ns > _connect_timeout_ms * 1000000ULL)
+				{
+					print_error("TCPClient connect: timeout");
+					return _fail_connect(nullptr);
+				}
+				return false;
 			}
+			int err = 0;
+			socklen_t len = sizeof(err);
+			if (getsockopt(_sock, SOL_SOCKET, SO_ERROR, &err, &len) != 0)
+				return _fail_connect("TCPClient getsockopt");
+			if (err != 0)
+			{
+				errno = err;
+				return _fail_connect("TCPClient connect");
+			}
+			return _connected();
+		}
+
+		// Подключение установлено: сокет возвращается в блокирующий режим (send_data).
+		// Задержка переподключения сбрасывается после получения данных или через stable_ms,
+		// чтобы сервер, который принимает и сразу закрывает подключение, не вызывал частых переподключений.
+		bool _connected()
+		{
+			const int flags = fcntl(_sock, F_GETFL, 0);
+			if (flags >= 0)
+				fcntl(_sock, F_SETFL, flags & ~O_NONBLOCK);
+			_state = state_enum::CONNECTED;
+			_connect_ns = time::ns();
 			return true;
 		}
 
 	public:
-		TCPClient()
+		TCPClient() :
+			_rand(static_cast<std::minstd_rand::result_type>(time::now()))
 		{
 			memset(&_addr, 0, sizeof(sockaddr_in));
 			_addr.sin_family = AF_INET;
@@ -56,28 +158,44 @@ namespace app
 
 		void end()
 		{
-			if (_sock < 0)
-				return;
-			close(_sock);
-			_sock = -1;
+			_close();
+			_fail = 0;
+			_next_ns = 0;
 		}
 
+		// Без переподключения (reconnect_ms = 0) подключение ожидается не дольше connect_timeout_ms.
 		bool beg(const app::Config& cfg)
 		{
+			end();
 			_addr.sin_addr.s_addr = inet_addr(cfg.get_cstr("host", "127.0.0.1"));
 			_addr.sin_port = htons(cfg.get<uint16_t>("port", 8000));
 			_reconnect_ms = cfg.get<uint32_t>("reconnect_ms", 0);
+			_reconnect_max_ms = std::max(_reconnect_ms, cfg.get<uint32_t>("reconnect_max_ms", 30000));
+			_connect_timeout_ms = cfg.get<uint32_t>("connect_timeout_ms", 3000);
+			_stable_ms = cfg.get<uint32_t>("stable_ms", 10000);
 			_buf.resize(cfg.get<uint32_t>("buf_size", 1024));
-			if (_sock >= 0)
-				close(_sock);
 			bool ok = _connect();
 			if (_reconnect_ms > 0)
 				return true;
+			while (!ok && _state == state_enum::CONNECTING)
+				ok = _check_connect(10);
 			return ok;
 		}
 
+		state_enum state() const
+		{
+			return _state;
+		}
+
+		bool is_connected() const
+		{
+			return _state == state_enum::CONNECTED;
+		}
+
 		bool send_data(const char* const data, size_t size)
 		{
+			if (_state != state_enum::CONNECTED)
+				return false;
 			int res = static_cast<int>(send(_sock, data, (size_t)size, MSG_NOSIGNAL));
 			if (res < 0)
 				return print_errno("TCPClient send");
@@ -94,31 +212,43 @@ namespace app
 			return send_data(str.data(), str.size());
 		}
 
-		// TODO. Обработка ошибок.
+		// Чтение данных без ожидания.
+		// Подключение и переподключение выполняются без блокировки.
 		bool update()
 		{
-			// Попытка переподключения.
-			if (_sock < 0)
+			_data_size = 0;
+			if (_state == state_enum::DISCONNECTED)
 			{
 				if (_reconnect_ms == 0)
 					return false;
-				uint32_t now = time::ms();
-				if (now < _last_connect_ms)
+				if (time::ns() < _next_ns)
 					return false;
 				if (!_connect())
 					return false;
 			}
+			else if (_state == state_enum::CONNECTING)
+			{
+				if (!_check_connect(0))
+					return false;
+			}
 			const auto data_size = recv(_sock, _buf.data(), _buf.size(), MSG_DONTWAIT);
 			if (data_size < 0)
 			{
-				if (errno != 11)
-				{
-					print_errno("TCPClient recv");
-					end();
-				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					return _fail_connect("TCPClient recv");
+				if (_fail > 0 && time::ns() - _connect_ns > _stable_ms * 1000000ULL)
+					_fail = 0;
 				return false;
 			}
+			// Подключение закрыто сервером.
+			if (data_size == 0 && !_buf.empty())
+			{
+				print_error("TCPClient recv: connection closed");
+				return _fail_connect(nullptr);
+			}
 			_data_size = data_size;
+			if (_data_size > 0)
+				_fail = 0;
 			return _data_size > 0;
 		}
 
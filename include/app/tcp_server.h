@@ -4,28 +4,71 @@
 
 #pragma once
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <deque>
 #include <mutex>
 #include <string>
 #include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #define MG_ENABLE_LOG 0
 #include <mongoose/mongoose.h>
 #include "config.h"
+#include "metrics.h"
+#include "mg_wake.h"
 #include "thread.h"
 
 
 namespace app
 {
-	// WebSocket сервер.
+	// TCP сервер.
+	// Данные каждого подключения накапливаются в его буфере (c->recv) и делятся на кадры (framing).
+	// Кадры с идентификатором подключения помещаются в общую очередь.
+	// Исходящие сообщения ставятся в очередь (всем или одному подключению) и отправляются пакетом.
 	class TCPServer : public Thread
 	{
+	public:
+		// Разделение входящих данных на кадры.
+		enum class framing_enum
+		{
+			RAW,    // Данные в порядке поступления (кадр - одно чтение).
+			LINE,   // Строки (\n или \r\n, без разделителя).
+			LENGTH, // Размер кадра перед данными (length_size байт, big-endian).
+			NMEA    // Предложения NMEA 0183 ($ или !, без \r\n), данные между предложениями отбрасываются.
+		};
+
 	private:
+		// Полученный кадр.
+		struct frame_struct
+		{
+			std::string data;
+			unsigned long id; // Идентификатор подключения.
+		};
+
+		// Сообщение для отправки.
+		struct write_struct
+		{
+			std::string data;
+			unsigned long id; // Идентификатор подключения (0 - всем).
+		};
+
 		struct server_data_struct
 		{
 			std::vector<mg_connection*> tcp_arr; // Список подключений.
-			bool is_read_data = false;
-			std::string read_data;
-			bool is_write_data = false;
-			std::string write_data;
+			volatile bool is_read_data = false;
+			std::deque<frame_struct> read_queue;  // Очередь полученных кадров.
+			std::vector<std::string> read_free;   // Освобождённые буферы для новых кадров.
+			size_t queue_limit = 1024;            // Размер очереди кадров.
+			size_t overflow = 0;                  // Отброшено кадров при переполнении очереди.
+			volatile bool is_write_data = false;
+			std::deque<write_struct> write_queue; // Очередь сообщений для отправки.
+			std::vector<std::string> write_free;  // Освобождённые буферы для новых сообщений.
+			size_t write_limit = 1024;            // Размер очереди сообщений для отправки.
+			size_t write_overflow = 0;            // Отброшено сообщений при переполнении очереди.
 			std::mutex mutex;
 
 			// Удаление подключения.
@@ -62,33 +105,207 @@ namespace app
 		mg_mgr _mgr;
 		server_data_struct _server_data;
 		int _min_ms = 5;
+		MgWake _wake; // Немедленная отправка данных без ожидания mg_mgr_poll.
 		std::string _read_data;
+		framing_enum _framing = framing_enum::RAW;
+		size_t _length_size = 4;    // Размер поля длины кадра (LENGTH).
+		size_t _read_limit = 65536; // Максимальный размер неполного кадра в буфере подключения (байт).
+		size_t _send_limit = 1048576; // Максимальный размер очереди отправки подключения (байт).
+		bool _nodelay = false;      // TCP_NODELAY: отправка без ожидания (алгоритм Нейгла отключен).
+		bool _cork = false;         // TCP_CORK: пакет сообщений отправляется полными сегментами.
+		std::vector<int> _cork_fd;  // Сокеты, закрытые TCP_CORK на время отправки пакета.
+		std::deque<write_struct> _write_queue; // Сообщения текущей отправки.
+		std::vector<iovec> _iov;
+		metrics::Metric& _m_frame = metrics::counter("tcp_recv_frame_total", "TCP frames received");
+		metrics::Metric& _m_overflow = metrics::counter("tcp_recv_overflow_total", "TCP frames dropped: receive queue full");
+		metrics::Metric& _m_discard = metrics::counter("tcp_recv_discard_bytes_total", "TCP bytes discarded: frame too large or not framed");
+		metrics::Metric& _m_send = metrics::counter("tcp_send_bytes_total", "TCP bytes sent");
+		metrics::Metric& _m_send_drop = metrics::counter("tcp_send_drop_total", "TCP messages dropped: client send queue full");
+		metrics::Metric& _m_write_overflow = metrics::counter("tcp_write_overflow_total", "TCP messages dropped: write queue full");
+
+		// Поиск кадра в начале данных.
+		// Возвращает количество использованных байт (0 - кадр ещё не получен полностью).
+		// Кадр - data[beg, beg + size), если size = 0, то данные отбрасываются.
+		size_t _parse(const char* data, size_t len, size_t& beg, size_t& size) const
+		{
+			beg = 0;
+			size = 0;
+			if (_framing == framing_enum::RAW)
+			{
+				size = len;
+				return len;
+			}
+			if (_framing == framing_enum::LENGTH)
+			{
+				if (len < _length_size)
+					return 0;
+				size_t n = 0;
+				for (size_t i = 0; i < _length_size; ++i)
+					n = (n << 8) | static_cast<uint8_t>(data[i]);
+				// Ошибка размера: данные подключения отбрасываются.
+				if (n > _read_limit)
+				{
+					_m_discard.inc(len);
+					return len;
+				}
+				if (len < _length_size + n)
+					return 0;
+				beg = _length_size;
+				size = n;
+				return _length_size + n;
+			}
+			if (_framing == framing_enum::NMEA)
+			{
+				// Начало предложения.
+				size_t i = 0;
+				while (i < len && data[i] != '$' && data[i] != '!')
+					++i;
+				if (i > 0)
+				{
+					_m_discard.inc(i);
+					return i;
+				}
+			}
+			const char* end = static_cast<const char*>(std::memchr(data, '\n', len));
+			if (!end)
+				return 0;
+			size = static_cast<size_t>(end - data);
+			if (size > 0 && data[size - 1] == '\r')
+				--size;
+			return static_cast<size_t>(end - data) + 1;
+		}
+
+		// Разделение данных подключения на кадры.
+		void _read(mg_connection* c)
+		{
+			mg_iobuf* r = &c->recv;
+			if (r->len < 1)
+				return;
+			size_t ofs = 0;
+			{
+				std::lock_guard<std::mutex> guard(_server_data.mutex);
+				auto& queue = _server_data.read_queue;
+				while (ofs < r->len)
+				{
+					const char* data = (const char*)r->buf + ofs;
+					size_t beg;
+					size_t size;
+					const size_t n = _parse(data, r->len - ofs, beg, size);
+					if (n == 0)
+						break;
+					ofs += n;
+					if (size == 0)
+						continue;
+					if (queue.size() >= _server_data.queue_limit)
+					{
+						// Новый кадр отбрасывается, уже принятые сохраняются.
+						++_server_data.overflow;
+						_m_overflow.inc();
+						continue;
+					}
+					queue.emplace_back();
+					auto& frame = queue.back();
+					if (!_server_data.read_free.empty())
+					{
+						frame.data.swap(_server_data.read_free.back());
+						_server_data.read_free.pop_back();
+					}
+					frame.data.assign(data + beg, size);
+					frame.id = c->id;
+					_m_frame.inc();
+					_server_data.is_read_data = true;
+				}
+			}
+			mg_iobuf_del(r, 0, ofs);
+			// Неполный кадр больше допустимого размера.
+			if (r->len > _read_limit)
+			{
+				_m_discard.inc(r->len);
+				r->len = 0;
+			}
+		}
 
 		static void _handler(mg_connection* c, int ev, void*, void* fn_data)
 		{
+			TCPServer* server = (TCPServer*)fn_data;
 			if (ev == MG_EV_ACCEPT)
 			{
-				server_data_struct* server_data = (server_data_struct*)fn_data;
-				server_data->add(c);
+				if (server->_nodelay)
+				{
+					const int one = 1;
+					setsockopt(static_cast<int>(reinterpret_cast<size_t>(c->fd)), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+				}
+				server->_server_data.add(c);
 			}
 			else if (ev == MG_EV_CLOSE)
+				server->_server_data.del(c);
+			else if (ev == MG_EV_READ)
+				server->_read(c);
+		}
+
+		void _cork_set(int fd, int val)
+		{
+			setsockopt(fd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val));
+		}
+
+		// Отправка сообщений подключению одним вызовом (_iov).
+		// Если очередь mongoose пуста, данные пишутся в сокет напрямую без копирования.
+		// Неотправленный остаток копируется в очередь mongoose.
+		void _write(mg_connection* c)
+		{
+			size_t n = 0;
+			if (c->send.len == 0 && !c->is_tls)
 			{
-				server_data_struct* server_data = (server_data_struct*)fn_data;
-				server_data->del(c);
+				const int fd = static_cast<int>(reinterpret_cast<size_t>(c->fd));
+				// TCP_CORK снимается после отправки всего пакета (_thread_run).
+				if (_cork)
+				{
+					_cork_set(fd, 1);
+					_cork_fd.push_back(fd);
+				}
+				msghdr msg = {};
+				msg.msg_iov = _iov.data();
+				msg.msg_iovlen = std::min<size_t>(_iov.size(), IOV_MAX);
+				const ssize_t res = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+				if (res > 0)
+					n = static_cast<size_t>(res);
 			}
-			else if (ev == MG_EV_READ)
+			for (const auto& iov : _iov)
 			{
-				mg_iobuf* r = &c->recv;
-				if (r->len < 1)
-					return;
-				server_data_struct* server_data = (server_data_struct*)fn_data;
+				_m_send.inc(iov.iov_len);
+				if (n >= iov.iov_len)
+				{
+					n -= iov.iov_len;
+					continue;
+				}
+				mg_send(c, static_cast<const char*>(iov.iov_base) + n, iov.iov_len - n);
+				n = 0;
+			}
+		}
+
+		// Отправка подключению адресованных ему сообщений.
+		void _flush(mg_connection* c)
+		{
+			if (c->is_closing || c->is_draining)
+				return;
+			const bool full = c->send.len > _send_limit;
+			_iov.clear();
+			for (const auto& msg : _write_queue)
+			{
+				if (msg.id != 0 && msg.id != c->id)
+					continue;
+				if (full)
 				{
-					std::lock_guard<std::mutex> guard(server_data->mutex);
-					server_data->read_data += std::string((char*)r->buf, r->len);
-					r->len = 0;
-					server_data->is_read_data = true;
+					_m_send_drop.inc();
+					continue;
 				}
+				iovec iov;
+				iov.iov_base = const_cast<char*>(msg.data.data());
+				iov.iov_len = msg.data.size();
+				_iov.push_back(iov);
 			}
+			if (!_iov.empty())
+				_write(c);
 		}
 
 		// Обработка в отдельном потоке.
@@ -96,15 +313,23 @@ namespace app
 		{
 			mg_mgr_poll(&_mgr, _min_ms);
 			//
-			const size_t len = _server_data.tcp_arr.size();
-			if (len == 0 || !_server_data.is_write_data)
+			if (!_server_data.is_write_data)
 				return;
+			// Забираем сообщения (без копирования данных) и отправляем без блокировки.
+			{
+				std::lock_guard<std::mutex> guard(_server_data.mutex);
+				_write_queue.swap(_server_data.write_queue);
+				_server_data.is_write_data = false;
+			}
+			for (auto c : _server_data.tcp_arr)
+				_flush(c);
+			for (int fd : _cork_fd)
+				_cork_set(fd, 0);
+			_cork_fd.clear();
 			std::lock_guard<std::mutex> guard(_server_data.mutex);
-			_server_data.is_write_data = false;
-			size_t data_len = _server_data.write_data.size();
-			const char* data = _server_data.write_data.c_str();
-			for (size_t i = 0; i < len; ++i)
-				mg_send(_server_data.tcp_arr[i], data, data_len);
+			for (auto& msg : _write_queue)
+				_server_data.write_free.push_back(std::move(msg.data));
+			_write_queue.clear();
 		}
 
 	public:
@@ -114,6 +339,7 @@ namespace app
 				return;
 			thread_end();
 			mg_mgr_free(&_mgr);
+			_wake.end();
 			_ok = false;
 		}
 
@@ -122,9 +348,29 @@ namespace app
 			end();
 			_min_ms = cfg.get("min_ms", 5);
 			int port = cfg.get("port", 8089, 1, 65535);
+			// Разделение входящих данных на кадры (raw, line, length, nmea) и ограничения буферов.
+			const std::string framing = cfg.get<std::string>("framing", "raw");
+			if (framing == "line")
+				_framing = framing_enum::LINE;
+			else if (framing == "length")
+				_framing = framing_enum::LENGTH;
+			else if (framing == "nmea")
+				_framing = framing_enum::NMEA;
+			else
+				_framing = framing_enum::RAW;
+			_length_size = cfg.get<size_t>("length_size", 4, 1, 4);
+			_read_limit = cfg.get<size_t>("read_limit", 65536);
+			_server_data.queue_limit = cfg.get<size_t>("queue_limit", 1024);
+			// Очередь отправки: размер (сообщений), ограничение очереди подключения (байт), параметры сокета.
+			_server_data.write_limit = cfg.get<size_t>("write_limit", 1024);
+			_send_limit = cfg.get<size_t>("send_limit", 1048576);
+			_nodelay = cfg.get("nodelay", false);
+			_cork = cfg.get("cork", false);
 			std::string url = "tcp://0.0.0.0:" + std::to_string(port);
 			mg_mgr_init(&_mgr);
-			mg_listen(&_mgr, url.c_str(), TCPServer::_handler, &_server_data);
+			if (!_wake.beg(&_mgr))
+				std::cout << "wakeup not available" << std::endl;
+			mg_listen(&_mgr, url.c_str(), TCPServer::_handler, this);
 			thread_run();
 			_ok = true;
 			return true;
@@ -135,20 +381,88 @@ namespace app
 			return _server_data.is_read_data;
 		}
 
+		// Все полученные кадры одной строкой (кадры LINE и NMEA завершаются \n).
 		const std::string& read_data()
 		{
-			_read_data = "";
+			_read_data.clear();
 			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			auto& queue = _server_data.read_queue;
+			const bool line = _framing == framing_enum::LINE || _framing == framing_enum::NMEA;
+			for (auto& frame : queue)
+			{
+				_read_data += frame.data;
+				if (line)
+					_read_data += '\n';
+				_server_data.read_free.push_back(std::move(frame.data));
+			}
+			queue.clear();
 			_server_data.is_read_data = false;
-			_read_data.swap(_server_data.read_data);
 			return _read_data;
 		}
 
-		void write_data(const std::string& data)
+		// Получение первого кадра из очереди без копирования (обмен буферами).
+		// id - идентификатор подключения, от которого получен кадр.
+		// Прежняя память data переходит серверу для следующих кадров.
+		bool read_frame(std::string& data, unsigned long& id)
+		{
+			if (!_server_data.is_read_data)
+				return false;
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			auto& queue = _server_data.read_queue;
+			if (queue.empty())
+				return false;
+			auto& frame = queue.front();
+			data.swap(frame.data);
+			id = frame.id;
+			if (frame.data.capacity() > 0)
+				_server_data.read_free.push_back(std::move(frame.data));
+			queue.pop_front();
+			_server_data.is_read_data = !queue.empty();
+			return true;
+		}
+
+		// Количество кадров, отброшенных при переполнении очереди.
+		size_t read_overflow()
+		{
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			return _server_data.overflow;
+		}
+
+		// Сообщение для отправки подключению id (0 - всем подключениям).
+		// Сообщения отправляются в порядке добавления.
+		void write_data(const char* data, size_t len, unsigned long id)
 		{
 			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			auto& queue = _server_data.write_queue;
+			if (queue.size() >= _server_data.write_limit)
+			{
+				++_server_data.write_overflow;
+				_m_write_overflow.inc();
+				return;
+			}
+			queue.emplace_back();
+			auto& msg = queue.back();
+			if (!_server_data.write_free.empty())
+			{
+				msg.data.swap(_server_data.write_free.back());
+				_server_data.write_free.pop_back();
+			}
+			msg.data.assign(data, len);
+			msg.id = id;
 			_server_data.is_write_data = true;
-			_server_data.write_data = data;
+			_wake.wake();
+		}
+
+		void write_data(const std::string& data, unsigned long id = 0)
+		{
+			write_data(data.data(), data.size(), id);
+		}
+
+		// Количество сообщений, отброшенных при переполнении очереди отправки.
+		size_t write_overflow()
+		{
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			return _server_data.write_overflow;
 		}
 
 		~TCPServer()
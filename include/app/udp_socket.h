@@ -0,0 +1,335 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "config.h"
+#include "print.h"
+
+
+namespace app
+{
+	// Общая часть UDP отправителя и получателя.
+	class UDPSocket
+	{
+	protected:
+		int _sock = -1;
+		size_t _batch = 64; // Максимальное количество сообщений за один системный вызов.
+
+		// Создание сокета и размеры буферов (0 - по умолчанию).
+		bool _open(int snd_buf, int rcv_buf)
+		{
+			end();
+			_sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (_sock < 0)
+				return print_errno("UDPSocket socket");
+			if (snd_buf > 0 && setsockopt(_sock, SOL_SOCKET, SO_SNDBUF, &snd_buf, sizeof(snd_buf)) != 0)
+				print_errno("UDPSocket SO_SNDBUF");
+			if (rcv_buf > 0 && setsockopt(_sock, SOL_SOCKET, SO_RCVBUF, &rcv_buf, sizeof(rcv_buf)) != 0)
+				print_errno("UDPSocket SO_RCVBUF");
+			return true;
+		}
+
+		static bool _is_multicast(in_addr addr)
+		{
+			return IN_MULTICAST(ntohl(addr.s_addr));
+		}
+
+	public:
+		UDPSocket() = default;
+		UDPSocket(const UDPSocket&) = delete;
+		UDPSocket& operator=(const UDPSocket&) = delete;
+
+		~UDPSocket()
+		{
+			end();
+		}
+
+		void end()
+		{
+			if (_sock < 0)
+				return;
+			close(_sock);
+			_sock = -1;
+		}
+
+		bool is_open() const
+		{
+			return _sock >= 0;
+		}
+	};
+
+	// Отправка UDP сообщений (unicast, broadcast, multicast).
+	// Сообщения можно отправлять сразу (send_data) или накапливать (add) и отправлять пакетом (flush, sendmmsg).
+	class UDPSender : public UDPSocket
+	{
+	private:
+		sockaddr_in _addr;            // Адрес получателя.
+		std::vector<char> _data;      // Накопленные сообщения.
+		std::vector<size_t> _len;     // Размеры накопленных сообщений.
+		std::vector<iovec> _iov;
+		std::vector<mmsghdr> _msg;
+		size_t _drop = 0;             // Сообщения, которые не удалось отправить.
+
+	public:
+		UDPSender()
+		{
+			std::memset(&_addr, 0, sizeof(_addr));
+			_addr.sin_family = AF_INET;
+		}
+
+		bool beg(const app::Config& cfg)
+		{
+			_addr.sin_addr.s_addr = inet_addr(cfg.get_cstr("host", "127.0.0.1"));
+			_addr.sin_port = htons(cfg.get<uint16_t>("port", 8100));
+			_batch = cfg.get<size_t>("batch", 64, 1, 1024);
+			if (!_open(cfg.get<int>("snd_buf", 0), 0))
+				return false;
+			if (_is_multicast(_addr.sin_addr))
+			{
+				// Время жизни (количество маршрутизаторов), получение своих сообщений, интерфейс отправки.
+				const int ttl = cfg.get("ttl", 1, 0, 255);
+				const int loop = cfg.get("loop", true) ? 1 : 0;
+				setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+				setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+				const char* iface = cfg.get_cstr("iface", "");
+				if (iface[0] != '\0')
+				{
+					in_addr addr;
+					addr.s_addr = inet_addr(iface);
+					if (setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_IF, &addr, sizeof(addr)) != 0)
+						print_errno("UDPSender IP_MULTICAST_IF");
+				}
+			}
+			else if (cfg.get("broadcast", false))
+			{
+				const int one = 1;
+				if (setsockopt(_sock, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one)) != 0)
+					print_errno("UDPSender SO_BROADCAST");
+			}
+			return true;
+		}
+
+		// Отправка одного сообщения.
+		bool send_data(const char* data, size_t size)
+		{
+			if (_sock < 0)
+				return false;
+			if (sendto(_sock, data, size, MSG_NOSIGNAL, (const sockaddr*)&_addr, sizeof(_addr)) < 0)
+			{
+				++_drop;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					return print_errno("UDPSender send");
+				return false;
+			}
+			return true;
+		}
+
+		bool send_data(const std::string& str)
+		{
+			return send_data(str.data(), str.size());
+		}
+
+		// Добавление сообщения в пакет.
+		// Если накоплено batch сообщений, то пакет отправляется.
+		void add(const char* data, size_t size)
+		{
+			_data.insert(_data.end(), data, data + size);
+			_len.push_back(size);
+			if (_len.size() >= _batch)
+				flush();
+		}
+
+		void add(const std::string& str)
+		{
+			add(str.data(), str.size());
+		}
+
+		// Отправка накопленных сообщений (sendmmsg).
+		// Возвращает количество отправленных сообщений.
+		size_t flush()
+		{
+			const size_t n = _len.size();
+			if (n == 0 || _sock < 0)
+			{
+				_drop += n;
+				_data.clear();
+				_len.clear();
+				return 0;
+			}
+			// Указатели формируются после добавления всех сообщений (буфер мог быть перемещён).
+			_iov.resize(n);
+			_msg.resize(n);
+			size_t ofs = 0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				_iov[i].iov_base = &_data[ofs];
+				_iov[i].iov_len = _len[i];
+				ofs += _len[i];
+				std::memset(&_msg[i], 0, sizeof(mmsghdr));
+				_msg[i].msg_hdr.msg_name = &_addr;
+				_msg[i].msg_hdr.msg_namelen = sizeof(_addr);
+				_msg[i].msg_hdr.msg_iov = &_iov[i];
+				_msg[i].msg_hdr.msg_iovlen = 1;
+			}
+			size_t sent = 0;
+			while (sent < n)
+			{
+				const int res = sendmmsg(_sock, &_msg[sent], static_cast<unsigned>(n - sent), MSG_NOSIGNAL);
+				if (res <= 0)
+				{
+					if (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+						print_errno("UDPSender sendmmsg");
+					break;
+				}
+				sent += static_cast<size_t>(res);
+			}
+			_drop += n - sent;
+			_data.clear();
+			_len.clear();
+			return sent;
+		}
+
+		// Количество сообщений, которые не удалось отправить.
+		size_t drop_count() const
+		{
+			return _drop;
+		}
+	};
+
+	// Получение UDP сообщений (unicast, broadcast, multicast).
+	// update() читает все доступные сообщения (до batch) одним вызовом recvmmsg.
+	class UDPReceiver : public UDPSocket
+	{
+	private:
+		size_t _msg_size = 2048;      // Максимальный размер сообщения.
+		size_t _count = 0;            // Количество прочитанных сообщений.
+		std::vector<char> _buf;
+		std::vector<iovec> _iov;
+		std::vector<mmsghdr> _msg;
+		std::vector<sockaddr_in> _from;
+
+	public:
+		bool beg(const app::Config& cfg)
+		{
+			sockaddr_in addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = inet_addr(cfg.get_cstr("host", "0.0.0.0"));
+			addr.sin_port = htons(cfg.get<uint16_t>("port", 8100));
+			_batch = cfg.get<size_t>("batch", 64, 1, 1024);
+			_msg_size = cfg.get<size_t>("msg_size", 2048, 1, 65536);
+			if (!_open(0, cfg.get<int>("rcv_buf", 0)))
+				return false;
+			// Несколько получателей на одном порту (multicast).
+			if (cfg.get("reuse", true))
+			{
+				const int one = 1;
+				setsockopt(_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			}
+			// Группа multicast: приём на адрес группы и подключение к группе на интерфейсе iface.
+			const char* group = cfg.get_cstr("group", "");
+			ip_mreq mreq;
+			std::memset(&mreq, 0, sizeof(mreq));
+			if (group[0] != '\0')
+			{
+				mreq.imr_multiaddr.s_addr = inet_addr(group);
+				if (!_is_multicast(mreq.imr_multiaddr))
+				{
+					end();
+					return print_error("UDPReceiver not multicast group: ", group);
+				}
+				const char* iface = cfg.get_cstr("iface", "");
+				mreq.imr_interface.s_addr = iface[0] != '\0' ? inet_addr(iface) : htonl(INADDR_ANY);
+				addr.sin_addr = mreq.imr_multiaddr;
+			}
+			if (bind(_sock, (const sockaddr*)&addr, sizeof(addr)) != 0)
+			{
+				print_errno("UDPReceiver bind");
+				end();
+				return false;
+			}
+			if (group[0] != '\0' && setsockopt(_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0)
+			{
+				print_errno("UDPReceiver IP_ADD_MEMBERSHIP");
+				end();
+				return false;
+			}
+			_buf.resize(_batch * _msg_size);
+			_iov.resize(_batch);
+			_msg.resize(_batch);
+			_from.resize(_batch);
+			for (size_t i = 0; i < _batch; ++i)
+			{
+				_iov[i].iov_base = &_buf[i * _msg_size];
+				_iov[i].iov_len = _msg_size;
+			}
+			return true;
+		}
+
+		// Чтение доступных сообщений (без ожидания).
+		// Возвращает количество прочитанных сообщений.
+		size_t update()
+		{
+			_count = 0;
+			if (_sock < 0)
+				return 0;
+			for (size_t i = 0; i < _batch; ++i)
+			{
+				std::memset(&_msg[i], 0, sizeof(mmsghdr));
+				_msg[i].msg_hdr.msg_name = &_from[i];
+				_msg[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+				_msg[i].msg_hdr.msg_iov = &_iov[i];
+				_msg[i].msg_hdr.msg_iovlen = 1;
+			}
+			const int res = recvmmsg(_sock, _msg.data(), static_cast<unsigned>(_batch), MSG_DONTWAIT, nullptr);
+			if (res < 0)
+			{
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					print_errno("UDPReceiver recvmmsg");
+				return 0;
+			}
+			_count = static_cast<size_t>(res);
+			return _count;
+		}
+
+		// Количество сообщений, прочитанных последним update().
+		size_t count() const
+		{
+			return _count;
+		}
+
+		// Данные сообщения i (усечены до msg_size).
+		const char* data(size_t i) const
+		{
+			return &_buf[i * _msg_size];
+		}
+
+		size_t data_size(size_t i) const
+		{
+			return std::min<size_t>(_msg[i].msg_len, _msg_size);
+		}
+
+		// Сообщение было усечено (больше msg_size).
+		bool is_trunc(size_t i) const
+		{
+			return (_msg[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+		}
+
+		// Адрес отправителя сообщения i.
+		const sockaddr_in& from(size_t i) const
+		{
+			return _from[i];
+		}
+	};
+}
\ No newline at end of file
@@ -67,6 +67,7 @@
 #include <cstdint>
 #include <vector>
 #include "config.h"
+#include "metrics.h"
 #include "serial.h"
 #include "thread.h"
 
@@ -113,6 +114,10 @@ namespace app
 		uint16_t _msg_type = 0;
 		size_t _msg_size = 0;
 
+		metrics::Metric& _m_reset = metrics::counter("unicore_buffer_reset_total", "Unicore receive buffer resets");
+		metrics::Metric& _m_crc = metrics::counter("unicore_crc_error_total", "Unicore messages with invalid CRC");
+		metrics::Metric& _m_msg = metrics::counter("unicore_msg_total", "Unicore messages received");
+
 		agricb_struct _agricb;
 		volatile bool _agricb_ok = false;
 		agricb_struct _agricb_res;
@@ -190,6 +195,7 @@ namespace app
 				_state = state_enum::OK;
 			else
 			{
+				_m_crc.inc();
 				_state = state_enum::BEG;
 				_msg_idx += 3;
 			}
@@ -231,6 +237,7 @@ namespace app
 				//
 				_agricb_ok = true;
 			}
+			_m_msg.inc();
 			_buf_size -= _msg_idx + _msg_size;
 			if (_buf_size > 0)
 				std::memmove(&_buf[0], &_buf[_msg_idx + _msg_size], _buf_size);
@@ -247,6 +254,7 @@ namespace app
 				_buf_size = 0;
 				_state = state_enum::BEG;
 				std::cout << "Unicore buffer reset." << std::endl;
+				_m_reset.inc();
 			}
 			// Чтение порции данных.
 			_buf_size += _serial.read_data(&_buf[_buf_size], _buf.size() - _buf_size);
@@ -0,0 +1,138 @@
+// https://github.com/IOdissey/app
+// Copyright (c) 2025 Alexander Abramenkov. All rights reserved.
+// Distributed under the MIT License (license terms are at https://opensource.org/licenses/MIT).
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+
+namespace app
+{
+	// Сжатие сообщений WebSocket (RFC 7692, permessage-deflate).
+	// Сообщение сжимается raw deflate с Z_SYNC_FLUSH, завершающие байты 00 00 FF FF отбрасываются.
+	class WSDeflate
+	{
+	private:
+		z_stream _z;
+		bool _ok = false;
+		bool _inflate = false;
+		bool _context = false;       // Словарь сохраняется между сообщениями (context takeover).
+		size_t _max = 16777216;      // Максимальный размер распакованного сообщения.
+		std::vector<uint8_t> _in;
+
+	public:
+		WSDeflate()
+		{
+			std::memset(&_z, 0, sizeof(_z));
+		}
+
+		~WSDeflate()
+		{
+			end();
+		}
+
+		WSDeflate(const WSDeflate&) = delete;
+		WSDeflate& operator=(const WSDeflate&) = delete;
+
+		void end()
+		{
+			if (!_ok)
+				return;
+			if (_inflate)
+				inflateEnd(&_z);
+			else
+				deflateEnd(&_z);
+			std::memset(&_z, 0, sizeof(_z));
+			_ok = false;
+		}
+
+		// Сжатие.
+		// level - уровень сжатия [1, 9].
+		// context - использовать предыдущие сообщения как словарь (лучше сжатие, но поток на каждого клиента).
+		bool beg_deflate(int level, bool context)
+		{
+			end();
+			_inflate = false;
+			_context = context;
+			_ok = deflateInit2(&_z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+			return _ok;
+		}
+
+		// Распаковка (без context takeover со стороны клиента).
+		// max - максимальный размер распакованного сообщения.
+		bool beg_inflate(size_t max = 16777216)
+		{
+			end();
+			_inflate = true;
+			_context = false;
+			_max = max;
+			_ok = inflateInit2(&_z, -15) == Z_OK;
+			return _ok;
+		}
+
+		// Сжатие сообщения.
+		bool deflate(const char* data, size_t len, std::string& out)
+		{
+			if (!_ok || _inflate)
+				return false;
+			if (!_context)
+				deflateReset(&_z);
+			out.resize(deflateBound(&_z, len) + 16);
+			_z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+			_z.avail_in = static_cast<uInt>(len);
+			size_t n = 0;
+			while (true)
+			{
+				_z.next_out = reinterpret_cast<Bytef*>(&out[n]);
+				_z.avail_out = static_cast<uInt>(out.size() - n);
+				const int res = ::deflate(&_z, Z_SYNC_FLUSH);
+				if (res != Z_OK && res != Z_BUF_ERROR)
+					return false;
+				n = out.size() - _z.avail_out;
+				// Если выходной буфер заполнен не полностью, то сжатие завершено.
+				if (_z.avail_out > 0)
+					break;
+				out.resize(out.size() * 2);
+			}
+			if (n >= 4 && std::memcmp(&out[n - 4], "\x00\x00\xff\xff", 4) == 0)
+				n -= 4;
+			out.resize(n);
+			return true;
+		}
+
+		// Распаковка сообщения.
+		bool inflate(const char* data, size_t len, std::vector<char>& out)
+		{
+			if (!_ok || !_inflate)
+				return false;
+			inflateReset(&_z);
+			_in.assign(data, data + len);
+			_in.insert(_in.end(), {0x00, 0x00, 0xFF, 0xFF});
+			_z.next_in = _in.data();
+			_z.avail_in = static_cast<uInt>(_in.size());
+			out.resize(len * 4 + 64);
+			size_t n = 0;
+			while (true)
+			{
+				_z.next_out = reinterpret_cast<Bytef*>(&out[n]);
+				_z.avail_out = static_cast<uInt>(out.size() - n);
+				const int res = ::inflate(&_z, Z_SYNC_FLUSH);
+				if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+					return false;
+				n = out.size() - _z.avail_out;
+				if (res == Z_STREAM_END || (_z.avail_in == 0 && _z.avail_out > 0))
+					break;
+				if (out.size() >= _max)
+					return false;
+				out.resize(out.size() * 2);
+			}
+			out.resize(n);
+			return true;
+		}
+	};
+}
\ No newline at end of file
@@ -4,87 +4,424 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #define MG_ENABLE_LOG 0
 #include <mongoose/mongoose.h>
 #include "config.h"
+#include "metrics.h"
+#include "mg_wake.h"
+#include "rate.h"
+#include "spsc_queue.h"
 #include "thread.h"
+#include "time.h"
+#ifdef APP_WS_DEFLATE
+#include "ws_deflate.h"
+#endif
 
 
 namespace app
 {
 	// WebSocket сервер.
-	class WSServer : public Thread
+	// Подключения распределяются между потоками (threads), у каждого потока свой менеджер mongoose.
+	// Данные для отправки формируются один раз и передаются потокам через очереди без блокировок.
+	class WSServer
 	{
+	public:
+		// Поведение при переполнении очереди отправки клиента (send_limit).
+		enum class send_policy
+		{
+			// Пропуск сообщений, пока очередь не уменьшится (клиент получает последние данные).
+			// В режиме delta после пропуска клиент получает изменения только с нового полного снимка.
+			DROP,
+			CLOSE, // Отключение клиента.
+			RATE   // Пропуск сообщений и снижение частоты отправки клиенту.
+		};
+
+		// Статистика клиента.
+		struct client_stat
+		{
+			unsigned long id;
+			bool binary;
+			size_t depth; // Неотправленные данные (байт).
+			size_t sent;  // Отправлено сообщений.
+			size_t drop;  // Пропущено сообщений.
+			uint32_t skip; // Режим RATE: пропуск skip сообщений из skip + 1.
+			uint64_t seq;    // Номер последней отправленной рассылки.
+			uint64_t rtt_ns; // Время ответа на ping (0 - нет ответа).
+			uint64_t lag_ns; // Время ожидания самых старых неотправленных данных (0 - очередь пуста).
+		};
+
+		// Статистика сжатия (permessage-deflate).
+		struct deflate_stat
+		{
+			uint64_t count = 0; // Количество сжатий.
+			uint64_t in = 0;    // Исходный размер (байт).
+			uint64_t out = 0;   // Размер после сжатия (байт).
+			uint64_t ns = 0;    // Время сжатия (нс).
+
+			// Степень сжатия (размер после сжатия / исходный размер).
+			double ratio() const
+			{
+				return in > 0 ? static_cast<double>(out) / in : 1.0;
+			}
+		};
+
+		// Подписка группы клиентов.
+		struct sub_struct
+		{
+			size_t group;                      // Номер группы (клиенты с одинаковой подпиской).
+			std::vector<std::string> sections; // Секции верхнего уровня (пустой список - все секции).
+			uint32_t ms;                       // Период отправки (мс), 0 - как у остальных клиентов.
+		};
+
 	private:
-		struct server_data_struct
+		// Подключение.
+		struct client_struct
 		{
-			std::vector<mg_connection*> ws_arr; // Список подключений.
-			bool is_ws_new = false;             // Флаг нового подключения.
-			std::string json_get;               // Полученные данные.
-			std::string json_set;               // Данные для отправки.
-			volatile bool is_get_json = false;
-			volatile bool is_set_json = false;
-			std::mutex mutex;
+			mg_connection* conn;
+			bool binary = false; // Клиент получает данные в формате CBOR (/ws?fmt=cbor).
+			size_t sent = 0;
+			size_t drop = 0;
+			uint32_t skip = 0;
+			uint32_t skip_idx = 0;
+			int group = -1; // Группа подписки (-1 - полные данные).
+			bool deflate = false; // Согласовано сжатие permessage-deflate.
+			uint64_t seq = 0;
+			uint64_t rtt_ns = 0;
+			uint64_t queued = 0;  // Записано в очередь mongoose (байт, всего).
+			std::deque<std::pair<uint64_t, uint64_t>> pend{}; // Кадры в очереди mongoose: время формирования, queued после кадра.
+			bool need_full = true; // Кадры delta пропускаются до полного снимка (нет базы для изменений).
+			bool full_req = false; // Полный снимок для клиента уже запрошен (is_full_req).
+#ifdef APP_WS_DEFLATE
+			std::shared_ptr<WSDeflate> z = nullptr; // Сжатие со словарём клиента (deflate_once = false).
+#endif
+		};
 
-			// Удаление подключения.
-			void del(mg_connection* c)
+		// Сообщение для отправки.
+		// Заголовок кадра WebSocket формируется один раз, данные общие для всех клиентов.
+		struct frame_struct
+		{
+			uint8_t head[10];
+			size_t head_len = 0;
+			int op = 0;
+			uint64_t seq = 0; // Номер рассылки.
+			uint64_t ns = 0;  // Время формирования (time::now).
+			bool delta = false; // Изменения относительно предыдущего кадра (нельзя пропускать).
+			std::shared_ptr<const std::string> data;
+#ifdef APP_WS_DEFLATE
+			std::shared_ptr<frame_struct> deflate; // Сжатое сообщение (формируется один раз).
+#endif
+
+			// deflate - данные сжаты (бит RSV1).
+			void set(std::shared_ptr<const std::string> payload, int opcode, bool deflate = false)
 			{
-				const size_t len = ws_arr.size();
-				// Если нет ни одного ws подключения.
-				if (len == 0)
-					return;
-				// Ищем какое подключение было завершено.
-				size_t i = 0;
-				for (; i < len; ++i)
+				data = std::move(payload);
+				op = opcode;
+				const uint64_t len = data->size();
+				head[0] = static_cast<uint8_t>(0x80 | (deflate ? 0x40 : 0) | op);
+				if (len < 126)
 				{
-					if (ws_arr[i] == c)
-						break;
+					head[1] = static_cast<uint8_t>(len);
+					head_len = 2;
+				}
+				else if (len <= 0xFFFF)
+				{
+					head[1] = 126;
+					head[2] = static_cast<uint8_t>(len >> 8);
+					head[3] = static_cast<uint8_t>(len);
+					head_len = 4;
+				}
+				else
+				{
+					head[1] = 127;
+					for (int i = 0; i < 8; ++i)
+						head[2 + i] = static_cast<uint8_t>(len >> (56 - 8 * i));
+					head_len = 10;
 				}
-				if (i >= len)
-					return;
-				for (size_t j = i + 1; j < len; ++j)
-					ws_arr[j - 1] = ws_arr[j];
-				ws_arr.resize(len - 1);
-				std::cout << "ws clients: " <<  ws_arr.size() << std::endl;
 			}
 
-			// Добавление подключения.
-			void add(mg_connection* c)
+			size_t size() const
 			{
-				ws_arr.push_back(c);
-				std::cout << "ws clients: " <<  ws_arr.size() << std::endl;
-				if (!is_ws_new)
-				{
-					std::lock_guard<std::mutex> guard(mutex);
-					is_ws_new = true;
-				}
+				return head_len + data->size();
 			}
 		};
 
+		// Группа клиентов с одинаковой подпиской.
+		// Данные группы формируются один раз и отправляются всем её клиентам.
+		struct group_struct
+		{
+			std::vector<std::string> sections;
+			uint32_t ms = 0;
+			size_t pending = 0; // Количество потоков, которые ещё не применили подписку.
+		};
+
+		// Полученное сообщение.
+		struct msg_struct
+		{
+			std::vector<char> data; // Данные (с \0 в конце).
+			unsigned long id;       // Идентификатор подключения.
+		};
+
+		// Сообщение для потока подключений.
+		struct send_struct
+		{
+			int group = 0; // Группа подписки, SEND_JSON или SEND_CBOR.
+			frame_struct frame;
+		};
+
+		// Подключение, переданное другому потоку.
+		struct accept_struct
+		{
+			int fd = -1;
+			mg_addr rem; // Адрес клиента.
+			mg_addr loc; // Локальный адрес.
+		};
+
+		static constexpr int SEND_JSON = -1;
+		static constexpr int SEND_CBOR = -2;
+
+		// Поток со своим менеджером mongoose и частью подключений.
+		// Поток 0 принимает новые подключения и распределяет их между потоками.
+		class Shard : public Thread
+		{
+		public:
+			WSServer* server;
+			size_t idx;
+			mg_mgr mgr;
+			MgWake wake;                            // Немедленная отправка данных без ожидания mg_mgr_poll.
+			std::vector<client_struct> ws_arr;      // Список подключений.
+			SPSCQueue<send_struct> send_queue;      // Данные для отправки (из основного потока).
+			SPSCQueue<accept_struct> fd_queue;      // Новые подключения (из потока 0).
+			std::vector<std::pair<unsigned long, int>> sub_req; // Новые подписки (подключение, группа).
+			std::atomic<bool> is_sub_req{false};
+			std::atomic<bool> is_json_lost{false};  // Основные данные не поместились в очередь (цепочка delta прервана).
+			std::vector<size_t> group_clients;      // Количество клиентов в группах подписки.
+			std::vector<client_stat> stat;          // Статистика клиентов (копия для чтения из других потоков).
+			size_t stat_drop = 0;
+			deflate_stat stat_deflate;
+			size_t drop = 0;                        // Пропущено сообщений (все клиенты потока).
+			deflate_stat deflate;                   // Статистика сжатия.
+			std::vector<frame_struct> group_frame;  // Данные групп подписки для текущей отправки.
+			std::vector<frame_struct> json_frame;   // Основные данные для текущей отправки (по порядку).
+			Rate ping_rate;
+#ifdef APP_WS_DEFLATE
+			WSDeflate deflate_once;                 // Сжатие один раз для всех клиентов потока.
+			frame_struct deflate_frame;
+			WSDeflate inflater;                     // Распаковка полученных сообщений.
+			std::vector<char> inflate_buf;
+#endif
+
+			Shard(WSServer* server, size_t idx) :
+				server(server),
+				idx(idx),
+				send_queue(64),
+				fd_queue(256)
+			{
+			}
+
+		private:
+			void _thread_run() override
+			{
+				server->_shard_run(*this);
+			}
+		};
+
+		struct server_data_struct
+		{
+			std::atomic<bool> is_ws_new{false};   // Флаг нового подключения.
+			std::atomic<bool> is_full_req{false}; // Клиенту, пропустившему кадр delta, нужен полный снимок.
+			std::atomic<size_t> binary_count{0};  // Количество клиентов с форматом CBOR.
+			std::atomic<size_t> client_count{0};  // Количество клиентов (все потоки).
+			std::deque<msg_struct> json_get;      // Очередь полученных сообщений.
+			std::vector<std::vector<char>> json_free; // Освобождённые буферы для новых сообщений.
+			size_t get_limit = 64;                // Размер очереди полученных сообщений.
+			size_t get_overflow = 0;              // Отброшено сообщений при переполнении очереди.
+			size_t get_peak = 0;                  // Максимальная длина очереди.
+			volatile bool is_get_json = false;
+			std::vector<group_struct> groups;     // Группы подписки.
+			bool use_deflate = false;             // Сжатие permessage-deflate разрешено.
+			bool deflate_once = true;             // Сжатие один раз для всех клиентов (без context takeover).
+			int deflate_level = 6;
+			metrics::Metric& m_recv = metrics::counter("ws_recv_msg_total", "WebSocket messages received");
+			metrics::Metric& m_overflow = metrics::counter("ws_recv_overflow_total", "WebSocket messages dropped: receive queue full");
+			metrics::Metric& m_clients = metrics::gauge("ws_clients", "Connected WebSocket clients");
+			std::mutex mutex;
+		};
+
 		bool _ok = false;
-		mg_mgr _mgr;
+		std::vector<std::unique_ptr<Shard>> _shards;
 		server_data_struct _server_data;
 		int _min_ms = 5;
+		uint32_t _sleep_us = 100; // Пауза цикла потоков (Thread::set_sleep_us).
+		uint32_t _ping_ms = 1000; // Период ping для измерения времени ответа (0 - не отправлять).
+		uint64_t _seq = 0;        // Номер последней рассылки (используется потоком отправки).
+		send_policy _policy = send_policy::DROP;
+		size_t _send_limit = 1048576;
+		size_t _deflate_min = 64; // Минимальный размер сообщения для сжатия (байт).
+		size_t _next_shard = 0;   // Поток для следующего подключения (используется потоком 0).
+		mg_event_handler_t _lsn_pfn = nullptr; // Обработчик протокола http (устанавливает mg_http_listen).
+		void* _lsn_pfn_data = nullptr;
+		metrics::Metric& _m_frames = metrics::counter("ws_send_frames_total", "WebSocket frames sent");
+		metrics::Metric& _m_bytes = metrics::counter("ws_send_bytes_total", "WebSocket bytes sent (with frame headers)");
+		metrics::Metric& _m_drop = metrics::counter("ws_send_drop_total", "WebSocket frames dropped by send policy");
+		metrics::Metric& _m_rtt = metrics::summary("ws_rtt_seconds", "WebSocket ping round-trip time");
+		metrics::Metric& _m_queue_drop = metrics::counter("ws_shard_queue_drop_total", "WebSocket frames dropped: shard queue full");
+		metrics::Metric& _m_deflate_in = metrics::counter("ws_deflate_in_bytes_total", "WebSocket bytes before compression");
+		metrics::Metric& _m_deflate_out = metrics::counter("ws_deflate_out_bytes_total", "WebSocket bytes after compression");
+		metrics::Metric& _m_deflate_time = metrics::summary("ws_deflate_seconds", "WebSocket compression time");
 
-		static void _request_handler(mg_connection* c, int ev, void* ev_data, void* fn_data)
+		// Удаление подключения.
+		void _del(Shard& shard, mg_connection* c)
 		{
-			if (ev == MG_EV_CLOSE)
+			auto& ws_arr = shard.ws_arr;
+			const size_t len = ws_arr.size();
+			// Если нет ни одного ws подключения.
+			if (len == 0)
+				return;
+			// Ищем какое подключение было завершено.
+			size_t i = 0;
+			for (; i < len; ++i)
+			{
+				if (ws_arr[i].conn == c)
+					break;
+			}
+			if (i >= len)
+				return;
+			if (ws_arr[i].binary)
+				--_server_data.binary_count;
+			// Пересчёт клиентов в группах подписки.
+			if (ws_arr[i].group >= 0)
+				shard.is_sub_req = true;
+			for (size_t j = i + 1; j < len; ++j)
+				ws_arr[j - 1] = std::move(ws_arr[j]);
+			ws_arr.resize(len - 1);
+			const size_t count = --_server_data.client_count;
+			_server_data.m_clients.set(static_cast<double>(count));
+			std::cout << "ws clients: " << count << std::endl;
+		}
+
+		// Добавление подключения.
+		void _add(Shard& shard, mg_connection* c, bool binary, bool deflate)
+		{
+			auto& ws_arr = shard.ws_arr;
+			ws_arr.push_back({c, binary});
+			ws_arr.back().deflate = deflate;
+#ifdef APP_WS_DEFLATE
+			if (deflate && !_server_data.deflate_once)
 			{
-				server_data_struct* server_data = (server_data_struct*)fn_data;
-				server_data->del(c);
+				auto z = std::make_shared<WSDeflate>();
+				if (z->beg_deflate(_server_data.deflate_level, true))
+					ws_arr.back().z = z;
+				else
+					ws_arr.back().deflate = false;
 			}
+#endif
+			if (binary)
+				++_server_data.binary_count;
+			const size_t count = ++_server_data.client_count;
+			_server_data.m_clients.set(static_cast<double>(count));
+			std::cout << "ws clients: " << count << std::endl;
+			_server_data.is_ws_new = true;
+		}
+
+		// Передача принятого подключения другому потоку (вызывается потоком 0).
+		// Сокет дублируется, копия регистрируется в менеджере выбранного потока,
+		// а подключение потока 0 закрывается (данные из сокета ещё не прочитаны).
+		void _accept(mg_connection* c)
+		{
+			const size_t n = _shards.size();
+			if (n < 2 || c->is_tls)
+				return;
+			Shard& shard = *_shards[_next_shard++ % n];
+			if (shard.idx == 0)
+				return;
+			accept_struct acc;
+			acc.fd = dup(static_cast<int>(reinterpret_cast<size_t>(c->fd)));
+			if (acc.fd < 0)
+				return;
+			acc.rem = c->rem;
+			acc.loc = c->loc;
+			// Если очередь заполнена, то подключение остаётся в потоке 0.
+			if (!shard.fd_queue.push(acc))
+			{
+				close(acc.fd);
+				return;
+			}
+			c->is_closing = 1;
+			shard.wake.wake();
+		}
+
+		// Регистрация переданных подключений.
+		void _accept_fd(Shard& shard)
+		{
+			accept_struct acc;
+			while (shard.fd_queue.pop(acc))
+			{
+				mg_connection* c = mg_wrapfd(&shard.mgr, acc.fd, WSServer::_request_handler, &shard);
+				if (!c)
+				{
+					close(acc.fd);
+					continue;
+				}
+				// Как у подключения, принятого mongoose.
+				c->rem = acc.rem;
+				c->loc = acc.loc;
+				c->pfn = _lsn_pfn;
+				c->pfn_data = _lsn_pfn_data;
+				c->is_accepted = 1;
+			}
+		}
+
+		static void _request_handler(mg_connection* c, int ev, void* ev_data, void* fn_data)
+		{
+			Shard& shard = *(Shard*)fn_data;
+			WSServer& server = *shard.server;
+			server_data_struct& server_data = server._server_data;
+			if (ev == MG_EV_ACCEPT)
+				server._accept(c);
+			else if (ev == MG_EV_CLOSE)
+				server._del(shard, c);
 			else if (ev == MG_EV_HTTP_MSG)
 			{
 				mg_http_message* http_msg = (mg_http_message*)ev_data;
 				if (mg_http_match_uri(http_msg, "/ws"))
 				{
 					std::cout << "http: /ws" << std::endl;
-					server_data_struct* server_data = (server_data_struct*)fn_data;
-					server_data->add(c);
-					mg_ws_upgrade(c, http_msg, nullptr);
+					char fmt[8];
+					const bool binary = mg_http_get_var(&http_msg->query, "fmt", fmt, sizeof(fmt)) > 0 && std::strcmp(fmt, "cbor") == 0;
+					bool deflate = false;
+#ifdef APP_WS_DEFLATE
+					// Сжатие с параметрами по умолчанию. Клиент всегда сжимает без словаря.
+					// Если клиент ограничивает окно сервера, то сжатие не используется.
+					const mg_str* ext = mg_http_get_header(http_msg, "Sec-WebSocket-Extensions");
+					deflate = server_data.use_deflate && ext &&
+						mg_strstr(*ext, mg_str_n("permessage-deflate", 18)) &&
+						!mg_strstr(*ext, mg_str_n("server_max_window_bits", 22));
+#endif
+					server._add(shard, c, binary, deflate);
+					if (!deflate)
+						mg_ws_upgrade(c, http_msg, nullptr);
+					else if (server_data.deflate_once)
+						mg_ws_upgrade(c, http_msg, "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; client_no_context_takeover\r\n");
+					else
+						mg_ws_upgrade(c, http_msg, "Sec-WebSocket-Extensions: permessage-deflate; client_no_context_takeover\r\n");
+				}
+				else if (mg_http_match_uri(http_msg, "/metrics"))
+				{
+					std::string text;
+					metrics::text(text);
+					mg_http_reply(c, 200, "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n", "%s", text.c_str());
 				}
 				else if (mg_http_match_uri(http_msg, "/ok"))
 				{
@@ -92,44 +429,474 @@ namespace app
 					mg_http_reply(c, 200, "Content-Type: application/json; charset=utf-8\r\nAccess-Control-Allow-Origin: *\r\n", "{\"status\": \"ok\"}\n");
 				}
 			}
+			else if (ev == MG_EV_WS_CTL)
+			{
+				// Ответ на ping: время отправки ping в данных.
+				mg_ws_message* wm = (mg_ws_message*)ev_data;
+				uint64_t ns;
+				if ((wm->flags & 0x0F) == WEBSOCKET_OP_PONG && wm->data.len == sizeof(ns))
+				{
+					std::memcpy(&ns, wm->data.ptr, sizeof(ns));
+					server._pong(shard, c, ns);
+				}
+			}
 			else if (ev == MG_EV_WS_MSG)
 			{
 				mg_ws_message* wm = (mg_ws_message*)ev_data;
 				if (wm->data.len < 1)
 					return;
-				server_data_struct* server_data = (server_data_struct*)fn_data;
+				const char* data = wm->data.ptr;
+				size_t data_len = wm->data.len;
+#ifdef APP_WS_DEFLATE
+				// Сжатое сообщение (бит RSV1).
+				if (wm->flags & 0x40)
 				{
-					std::lock_guard<std::mutex> guard(server_data->mutex);
-					server_data->json_get = std::string(wm->data.ptr, wm->data.len);
-					server_data->is_get_json = true;
+					auto& buf = shard.inflate_buf;
+					if (!shard.inflater.inflate(data, data_len, buf) || buf.empty())
+					{
+						mg_iobuf_del(&c->recv, 0, c->recv.len);
+						return;
+					}
+					data = buf.data();
+					data_len = buf.size();
+				}
+#endif
+				{
+					std::lock_guard<std::mutex> guard(server_data.mutex);
+					auto& queue = server_data.json_get;
+					if (queue.size() >= server_data.get_limit)
+					{
+						// Новое сообщение отбрасывается, уже принятые сохраняются.
+						++server_data.get_overflow;
+						server_data.m_overflow.inc();
+					}
+					else
+					{
+						queue.emplace_back();
+						auto& msg = queue.back();
+						if (!server_data.json_free.empty())
+						{
+							msg.data.swap(server_data.json_free.back());
+							server_data.json_free.pop_back();
+						}
+						msg.data.assign(data, data + data_len);
+						msg.data.push_back('\0');
+						msg.id = c->id;
+						server_data.m_recv.inc();
+						server_data.get_peak = std::max(server_data.get_peak, queue.size());
+						server_data.is_get_json = true;
+					}
 				}
 				mg_iobuf_del(&c->recv, 0, c->recv.len);
 			}
 		}
 
-		// Обработка http в отдельном потоке.
-		void _thread_run()
+		// Отправка ping всем клиентам потока.
+		void _ping(Shard& shard)
+		{
+			const uint64_t ns = time::now();
+			for (auto& client : shard.ws_arr)
+			{
+				mg_connection* c = client.conn;
+				if (!c->is_closing && !c->is_draining && c->is_websocket)
+					mg_ws_send(c, &ns, sizeof(ns), WEBSOCKET_OP_PING);
+			}
+		}
+
+		void _pong(Shard& shard, mg_connection* c, uint64_t ns)
+		{
+			const uint64_t now = time::now();
+			if (ns > now)
+				return;
+			for (auto& client : shard.ws_arr)
+			{
+				if (client.conn == c)
+				{
+					client.rtt_ns = now - ns;
+					_m_rtt.observe_ns(client.rtt_ns);
+					break;
+				}
+			}
+		}
+
+		// Запись кадра.
+		// Если очередь mongoose пуста, кадр пишется в сокет напрямую без копирования.
+		// Неотправленный остаток (или весь кадр, если очередь не пуста) копируется в очередь mongoose.
+		// Возвращает размер остатка (байт).
+		size_t _write(mg_connection* c, const frame_struct& frame)
+		{
+			const size_t len = frame.size();
+			_m_frames.inc();
+			_m_bytes.inc(len);
+			size_t n = 0;
+			if (c->send.len == 0 && !c->is_tls)
+			{
+				iovec iov[2];
+				iov[0].iov_base = const_cast<uint8_t*>(frame.head);
+				iov[0].iov_len = frame.head_len;
+				iov[1].iov_base = const_cast<char*>(frame.data->data());
+				iov[1].iov_len = frame.data->size();
+				msghdr msg = {};
+				msg.msg_iov = iov;
+				msg.msg_iovlen = 2;
+				const ssize_t res = sendmsg(static_cast<int>(reinterpret_cast<size_t>(c->fd)), &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+				if (res > 0)
+					n = static_cast<size_t>(res);
+			}
+			const size_t rest = len - n;
+			if (n < frame.head_len)
+			{
+				mg_send(c, frame.head + n, frame.head_len - n);
+				n = frame.head_len;
+			}
+			if (n < len)
+				mg_send(c, frame.data->data() + (n - frame.head_len), len - n);
+			return rest;
+		}
+
+#ifdef APP_WS_DEFLATE
+		// Сжатие сообщения.
+		bool _compress(Shard& shard, WSDeflate& z, const frame_struct& src, frame_struct& dst)
+		{
+			const uint64_t t = time::now();
+			auto out = std::make_shared<std::string>();
+			if (!z.deflate(src.data->data(), src.data->size(), *out))
+				return false;
+			const uint64_t ns = time::now() - t;
+			shard.deflate.ns += ns;
+			++shard.deflate.count;
+			shard.deflate.in += src.data->size();
+			shard.deflate.out += out->size();
+			_m_deflate_time.observe_ns(ns);
+			_m_deflate_in.inc(src.data->size());
+			_m_deflate_out.inc(out->size());
+			dst.set(std::move(out), src.op, true);
+			return true;
+		}
+
+		// Сжатое сообщение для клиента: общее для всех клиентов потока или со словарём клиента.
+		// При ошибке сжатия возвращается исходное сообщение.
+		const frame_struct& _deflate(Shard& shard, client_struct& client, frame_struct& frame)
+		{
+			if (client.z)
+				return _compress(shard, *client.z, frame, shard.deflate_frame) ? shard.deflate_frame : frame;
+			if (!frame.deflate)
+			{
+				frame.deflate = std::make_shared<frame_struct>();
+				if (!_compress(shard, shard.deflate_once, frame, *frame.deflate))
+					*frame.deflate = frame;
+			}
+			return *frame.deflate;
+		}
+#endif
+
+		// Отправка сообщения клиенту с учётом его очереди отправки.
+		// Очередь - данные, которые mongoose ещё не передал в сокет (c->send).
+		void _send(Shard& shard, client_struct& client, frame_struct& frame)
 		{
-			mg_mgr_poll(&_mgr, _min_ms);
+			mg_connection* c = client.conn;
+			if (c->is_closing || c->is_draining)
+				return;
+			const size_t depth = c->send.len;
+			// Изменения без базы (новый клиент, смена подписки, пропущенный кадр) не отправляются.
+			// Полный снимок запрашивается один раз, когда очередь клиента освободилась.
+			if (frame.delta && client.need_full)
+			{
+				if (!client.full_req && depth <= _send_limit)
+				{
+					client.full_req = true;
+					_server_data.is_full_req = true;
+				}
+				return;
+			}
+			const bool full = depth > _send_limit;
+			if (_policy == send_policy::CLOSE && full)
+			{
+				std::cout << "ws client " << c->id << " closed: send queue " << depth << " bytes" << std::endl;
+				++client.drop;
+				++shard.drop;
+				c->is_closing = 1;
+				return;
+			}
+			if (_policy == send_policy::RATE)
+			{
+				// Частота снижается вдвое при переполнении и восстанавливается, когда очередь пуста.
+				if (full)
+					client.skip = std::min<uint32_t>(client.skip * 2 + 1, 63);
+				else if (depth == 0 && client.skip > 0)
+					client.skip /= 2;
+				if (client.skip_idx < client.skip)
+				{
+					++client.skip_idx;
+					_drop(shard, client);
+					return;
+				}
+				client.skip_idx = 0;
+			}
+			if (full)
+			{
+				_drop(shard, client);
+				return;
+			}
+#ifdef APP_WS_DEFLATE
+			if (client.deflate && frame.data->size() >= _deflate_min)
+			{
+				_sent(client, frame, _write(c, _deflate(shard, client, frame)));
+				return;
+			}
+#endif
+			_sent(client, frame, _write(c, frame));
+		}
+
+		// Учёт пропущенного сообщения.
+		// Следующие кадры delta не имеют базы: клиент ждёт полного снимка.
+		void _drop(Shard& shard, client_struct& client)
+		{
+			++client.drop;
+			++shard.drop;
+			client.need_full = true;
+			client.full_req = false;
+		}
+
+		// Удаление из pend кадров, которые mongoose уже передал в сокет.
+		void _pend_update(client_struct& client)
+		{
+			const size_t depth = client.conn->send.len;
+			if (depth == 0)
+			{
+				client.pend.clear();
+				return;
+			}
+			const uint64_t done = client.queued > depth ? client.queued - depth : 0;
+			while (!client.pend.empty() && client.pend.front().second <= done)
+				client.pend.pop_front();
+		}
+
+		// Учёт отправленного сообщения.
+		// rest - часть кадра, записанная в очередь mongoose (байт).
+		void _sent(client_struct& client, const frame_struct& frame, size_t rest)
+		{
+			++client.sent;
+			client.seq = std::max(client.seq, frame.seq);
+			if (!frame.delta)
+			{
+				client.need_full = false;
+				client.full_req = false;
+			}
+			// Данные остались в очереди mongoose.
+			_pend_update(client);
+			if (rest > 0)
+			{
+				client.queued += rest;
+				client.pend.emplace_back(frame.ns, client.queued);
+			}
+		}
+
+		// Обновление статистики клиентов потока.
+		void _update_stat(Shard& shard)
+		{
+			auto& stat = shard.stat;
+			stat.resize(shard.ws_arr.size());
+			const uint64_t now = time::now();
+			for (size_t i = 0; i < stat.size(); ++i)
+			{
+				auto& client = shard.ws_arr[i];
+				const size_t depth = client.conn->send.len;
+				// Время ожидания самого старого кадра, который ещё не передан в сокет.
+				_pend_update(client);
+				const uint64_t pend_ns = client.pend.empty() ? 0 : client.pend.front().first;
+				const uint64_t lag = pend_ns > 0 && now > pend_ns ? now - pend_ns : 0;
+				stat[i] = {client.conn->id, client.binary, depth, client.sent, client.drop, client.skip, client.seq, client.rtt_ns, lag};
+			}
+			_m_drop.inc(shard.drop - shard.stat_drop);
+			shard.stat_drop = shard.drop;
+			shard.stat_deflate = shard.deflate;
+		}
+
+		// Применение новых подписок и подсчёт клиентов потока в группах.
+		void _update_sub(Shard& shard)
+		{
+			auto& groups = _server_data.groups;
+			shard.is_sub_req = false;
+			for (const auto& req : shard.sub_req)
+			{
+				for (auto& client : shard.ws_arr)
+				{
+					if (client.conn->id == req.first && client.group != req.second)
+					{
+						client.group = req.second;
+						client.need_full = true;
+					}
+				}
+				if (req.second >= 0 && groups[req.second].pending > 0)
+					--groups[req.second].pending;
+			}
+			shard.sub_req.clear();
+			shard.group_clients.assign(groups.size(), 0);
+			for (const auto& client : shard.ws_arr)
+			{
+				if (client.group >= 0)
+					++shard.group_clients[client.group];
+			}
+		}
+
+		// Количество клиентов группы (все потоки, вызывается с блокировкой).
+		size_t _group_clients(size_t group) const
+		{
+			size_t n = 0;
+			for (const auto& shard : _shards)
+			{
+				if (group < shard->group_clients.size())
+					n += shard->group_clients[group];
+			}
+			return n;
+		}
+
+		// Передача сообщения всем потокам (вызывается из одного потока).
+		void _push(int group, frame_struct&& frame)
+		{
+			// Номер рассылки увеличивается для основных данных, CBOR и группы получают номер текущего снимка.
+			if (group == SEND_JSON)
+				++_seq;
+			frame.seq = _seq;
+			frame.ns = time::now();
+			for (size_t i = 0; i < _shards.size(); ++i)
+			{
+				Shard& shard = *_shards[i];
+				// Последнему потоку сообщение передаётся без копирования.
+				send_struct msg;
+				msg.group = group;
+				if (i + 1 < _shards.size())
+					msg.frame = frame;
+				else
+					msg.frame = std::move(frame);
+				if (!shard.send_queue.push(std::move(msg)))
+				{
+					_m_queue_drop.inc();
+					if (group == SEND_JSON)
+						shard.is_json_lost = true;
+				}
+				shard.wake.wake();
+			}
+		}
+
+		// Обработка http в потоке подключений.
+		void _shard_run(Shard& shard)
+		{
+			mg_mgr_poll(&shard.mgr, _min_ms);
 			//
-			const size_t len = _server_data.ws_arr.size();
-			if (len == 0 || !_server_data.is_set_json)
+			if (shard.idx > 0)
+				_accept_fd(shard);
+			if (_ping_ms > 0 && shard.ping_rate.ok())
+				_ping(shard);
+			if (shard.is_sub_req)
+			{
+				std::lock_guard<std::mutex> guard(_server_data.mutex);
+				_update_sub(shard);
+			}
+			// Забираем сообщения (без копирования данных), из каждого вида отправляется последнее.
+			// Кадры delta зависят от предыдущих, поэтому основные данные отправляются все,
+			// начиная с последнего полного кадра.
+			auto& json = shard.json_frame;
+			frame_struct cbor;
+			bool is_set = false;
+			send_struct msg;
+			while (shard.send_queue.pop(msg))
+			{
+				if (msg.group == SEND_JSON)
+				{
+					if (!msg.frame.delta)
+						json.clear();
+					json.push_back(std::move(msg.frame));
+				}
+				else if (msg.group == SEND_CBOR)
+					cbor = std::move(msg.frame);
+				else
+				{
+					const size_t group = static_cast<size_t>(msg.group);
+					if (group >= shard.group_frame.size())
+						shard.group_frame.resize(group + 1);
+					shard.group_frame[group] = std::move(msg.frame);
+				}
+				is_set = true;
+			}
+			if (!is_set)
 				return;
-			std::lock_guard<std::mutex> guard(_server_data.mutex);
-			_server_data.is_set_json = false;
-			size_t data_len = _server_data.json_set.size();
-			const char* data = _server_data.json_set.c_str();
+			// После потерянного кадра изменения отправляются только с нового полного снимка.
+			if (shard.is_json_lost.exchange(false))
+			{
+				for (auto& client : shard.ws_arr)
+					client.need_full = true;
+			}
+			const size_t len = shard.ws_arr.size();
 			for (size_t i = 0; i < len; ++i)
-				mg_ws_send(_server_data.ws_arr[i], data, data_len, WEBSOCKET_OP_TEXT);
+			{
+				auto& client = shard.ws_arr[i];
+				if (client.binary)
+				{
+					if (cbor.data)
+						_send(shard, client, cbor);
+				}
+				else if (client.group >= 0)
+				{
+					if (static_cast<size_t>(client.group) < shard.group_frame.size())
+					{
+						auto& frame = shard.group_frame[client.group];
+						if (frame.data)
+							_send(shard, client, frame);
+					}
+				}
+				else
+				{
+					for (auto& frame : json)
+						_send(shard, client, frame);
+				}
+			}
+			json.clear();
+			for (auto& frame : shard.group_frame)
+				frame = frame_struct();
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			_update_stat(shard);
 		}
 
 	public:
+		// Управление потоками подключений (как у app::Thread, от которого раньше наследовался сервер).
+		void set_sleep_us(uint32_t sleep_us)
+		{
+			_sleep_us = sleep_us;
+			for (auto& shard : _shards)
+				shard->set_sleep_us(sleep_us);
+		}
+
+		void thread_run()
+		{
+			for (auto& shard : _shards)
+				shard->thread_run();
+		}
+
+		void thread_end()
+		{
+			for (auto& shard : _shards)
+				shard->thread_end();
+		}
+
 		void end()
 		{
 			if (!_ok)
 				return;
 			thread_end();
-			mg_mgr_free(&_mgr);
+			for (auto& shard : _shards)
+			{
+				mg_mgr_free(&shard->mgr);
+				shard->wake.end();
+				// Подключения, которые поток не успел принять.
+				accept_struct acc;
+				while (shard->fd_queue.pop(acc))
+					close(acc.fd);
+			}
+			_shards.clear();
+			_server_data.client_count = 0;
+			_server_data.binary_count = 0;
 			_ok = false;
 		}
 
@@ -137,10 +904,60 @@ namespace app
 		{
 			end();
 			_min_ms = cfg.get("min_ms", 5);
+			// Период ping (мс) для измерения времени ответа клиентов, 0 - не отправлять.
+			_ping_ms = cfg.get<uint32_t>("ping_ms", 1000);
+			_server_data.get_limit = cfg.get<size_t>("get_limit", 64);
 			int port = cfg.get("port", 8080, 1, 65535);
+			// Количество потоков подключений (у каждого свой менеджер mongoose и часть клиентов).
+			const int threads = cfg.get("threads", 1, 1, 64);
+			// Сжатие permessage-deflate (RFC 7692): уровень, сжатие один раз для всех клиентов
+			// (иначе поток со словарём на каждого клиента), минимальный размер сообщения.
+			_server_data.use_deflate = cfg.get("deflate", false);
+			_server_data.deflate_level = cfg.get("deflate_level", 6, 1, 9);
+			_server_data.deflate_once = cfg.get("deflate_once", true);
+			_deflate_min = cfg.get<size_t>("deflate_min", 64);
+#ifndef APP_WS_DEFLATE
+			if (_server_data.use_deflate)
+			{
+				std::cout << "ws deflate not available (APP_WS_DEFLATE)" << std::endl;
+				_server_data.use_deflate = false;
+			}
+#endif
+			// Ограничение очереди отправки клиента (байт) и поведение при переполнении (drop, close, rate).
+			_send_limit = cfg.get<size_t>("send_limit", 1048576);
+			const std::string policy = cfg.get<std::string>("send_policy", "drop");
+			if (policy == "close")
+				_policy = send_policy::CLOSE;
+			else if (policy == "rate")
+				_policy = send_policy::RATE;
+			else
+				_policy = send_policy::DROP;
+			_next_shard = 0;
+			for (int i = 0; i < threads; ++i)
+			{
+				_shards.emplace_back(new Shard(this, static_cast<size_t>(i)));
+				Shard& shard = *_shards.back();
+				mg_mgr_init(&shard.mgr);
+				shard.ping_rate.ms(_ping_ms);
+				if (!shard.wake.beg(&shard.mgr))
+					std::cout << "wakeup not available" << std::endl;
+#ifdef APP_WS_DEFLATE
+				if (_server_data.use_deflate)
+				{
+					_server_data.use_deflate = shard.deflate_once.beg_deflate(_server_data.deflate_level, false) &&
+						shard.inflater.beg_inflate();
+				}
+#endif
+			}
 			std::string url = "http://0.0.0.0:" + std::to_string(port);
-			mg_mgr_init(&_mgr);
-			mg_http_listen(&_mgr, url.c_str(), WSServer::_request_handler, &_server_data);
+			mg_connection* lsn = mg_http_listen(&_shards[0]->mgr, url.c_str(), WSServer::_request_handler, _shards[0].get());
+			if (lsn)
+			{
+				_lsn_pfn = lsn->pfn;
+				_lsn_pfn_data = lsn->pfn_data;
+			}
+			for (auto& shard : _shards)
+				shard->set_sleep_us(_sleep_us);
 			thread_run();
 			_ok = true;
 			return true;
@@ -156,27 +973,232 @@ namespace app
 			return _server_data.is_get_json;
 		}
 
+		// Первое сообщение из очереди (пустая строка, если очередь пуста).
 		std::string get_json()
 		{
-			std::lock_guard<std::mutex> guard(_server_data.mutex);
-			_server_data.is_get_json = false;
-			return _server_data.json_get;
+			std::vector<char> buf;
+			if (!get_json(buf) || buf.empty())
+				return std::string();
+			// Размер без \0 в конце (данные могут содержать \0).
+			return std::string(buf.data(), buf.size() - 1);
 		}
 
-		bool is_ws_new()
+		// Получение первого сообщения из очереди без копирования (обмен буферами).
+		// buf - буфер, который получит данные (строка с \0 в конце).
+		// id - идентификатор подключения, от которого получено сообщение.
+		// Прежняя память buf переходит серверу для следующих сообщений.
+		bool get_json(std::vector<char>& buf, unsigned long& id)
 		{
-			if (!_server_data.is_ws_new)
+			if (!_server_data.is_get_json)
 				return false;
 			std::lock_guard<std::mutex> guard(_server_data.mutex);
-			_server_data.is_ws_new = false;
+			auto& queue = _server_data.json_get;
+			if (queue.empty())
+				return false;
+			auto& msg = queue.front();
+			buf.swap(msg.data);
+			id = msg.id;
+			if (msg.data.capacity() > 0)
+				_server_data.json_free.push_back(std::move(msg.data));
+			queue.pop_front();
+			_server_data.is_get_json = !queue.empty();
 			return true;
 		}
 
-		void set_json(const std::string& json)
+		bool get_json(std::vector<char>& buf)
+		{
+			unsigned long id;
+			return get_json(buf, id);
+		}
+
+		// Количество сообщений в очереди.
+		size_t get_depth()
+		{
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			return _server_data.json_get.size();
+		}
+
+		// Максимальная длина очереди сообщений.
+		size_t get_peak()
+		{
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			return _server_data.get_peak;
+		}
+
+		// Количество сообщений, отброшенных при переполнении очереди.
+		size_t get_overflow()
+		{
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			return _server_data.get_overflow;
+		}
+
+		// Подписка клиента id на секции верхнего уровня с периодом ms.
+		// Пустой список секций и ms = 0 - отмена подписки (полные данные с общим периодом).
+		void subscribe(unsigned long id, std::vector<std::string> sections, uint32_t ms)
+		{
+			if (!_ok)
+				return;
+			std::sort(sections.begin(), sections.end());
+			sections.erase(std::unique(sections.begin(), sections.end()), sections.end());
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			auto& groups = _server_data.groups;
+			int group = -1;
+			if (!sections.empty() || ms > 0)
+			{
+				// Группа с такой же подпиской или свободная.
+				int free = -1;
+				for (size_t i = 0; i < groups.size(); ++i)
+				{
+					const bool used = groups[i].pending > 0 || _group_clients(i) > 0;
+					if (used && groups[i].ms == ms && groups[i].sections == sections)
+					{
+						group = static_cast<int>(i);
+						break;
+					}
+					if (!used && free < 0)
+						free = static_cast<int>(i);
+				}
+				if (group < 0)
+				{
+					if (free < 0)
+					{
+						free = static_cast<int>(groups.size());
+						groups.emplace_back();
+					}
+					group = free;
+					groups[group] = group_struct();
+					groups[group].sections = std::move(sections);
+					groups[group].ms = ms;
+				}
+				// Подписка применяется каждым потоком (клиент id есть только в одном из них).
+				groups[group].pending = _shards.size();
+			}
+			for (auto& shard : _shards)
+			{
+				shard->sub_req.emplace_back(id, group);
+				shard->is_sub_req = true;
+				shard->wake.wake();
+			}
+		}
+
+		// Группы подписки, у которых есть клиенты.
+		bool subs(std::vector<sub_struct>& subs)
+		{
+			subs.clear();
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			const auto& groups = _server_data.groups;
+			for (size_t i = 0; i < groups.size(); ++i)
+			{
+				if (_group_clients(i) > 0)
+					subs.push_back({i, groups[i].sections, groups[i].ms});
+			}
+			return !subs.empty();
+		}
+
+		// Данные для группы подписки (передаются без копирования).
+		void set_json(size_t group, std::string&& json)
+		{
+			if (group >= _server_data.groups.size())
+				return;
+			frame_struct frame;
+			frame.set(std::make_shared<const std::string>(std::move(json)), WEBSOCKET_OP_TEXT);
+			_push(static_cast<int>(group), std::move(frame));
+		}
+
+		// Статистика клиентов на момент последней отправки (все потоки).
+		std::vector<client_stat> clients()
 		{
+			std::vector<client_stat> stat;
 			std::lock_guard<std::mutex> guard(_server_data.mutex);
-			_server_data.is_set_json = true;
-			_server_data.json_set = json;
+			for (const auto& shard : _shards)
+				stat.insert(stat.end(), shard->stat.begin(), shard->stat.end());
+			return stat;
+		}
+
+		// Статистика сжатия на момент последней отправки (все потоки).
+		deflate_stat deflate()
+		{
+			deflate_stat stat;
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			for (const auto& shard : _shards)
+			{
+				stat.count += shard->stat_deflate.count;
+				stat.in += shard->stat_deflate.in;
+				stat.out += shard->stat_deflate.out;
+				stat.ns += shard->stat_deflate.ns;
+			}
+			return stat;
+		}
+
+		// Количество пропущенных сообщений (все клиенты).
+		size_t drop_count()
+		{
+			size_t drop = 0;
+			std::lock_guard<std::mutex> guard(_server_data.mutex);
+			for (const auto& shard : _shards)
+				drop += shard->stat_drop;
+			return drop;
+		}
+
+		// Номер последней рассылки (set_json).
+		uint64_t seq() const
+		{
+			return _seq;
+		}
+
+		bool is_ws_new()
+		{
+			return _server_data.is_ws_new.exchange(false);
+		}
+
+		// Нужен полный снимок (set_delta с full = true): клиент пропустил кадр из-за переполнения очереди.
+		bool is_full_req()
+		{
+			return _server_data.is_full_req.exchange(false);
+		}
+
+		// Данные для отправки (передаются без копирования).
+		// Методы отправки вызываются из одного потока.
+		void set_json(std::shared_ptr<const std::string> json)
+		{
+			frame_struct frame;
+			frame.set(std::move(json), WEBSOCKET_OP_TEXT);
+			_push(SEND_JSON, std::move(frame));
+		}
+
+		void set_json(std::string&& json)
+		{
+			set_json(std::make_shared<const std::string>(std::move(json)));
+		}
+
+		void set_json(const std::string& json)
+		{
+			set_json(std::make_shared<const std::string>(json));
+		}
+
+		// Данные в режиме delta (Json::end_delta).
+		// full - полный снимок. Изменения не объединяются при отправке и не отправляются клиентам,
+		// которые ещё не получили полный снимок.
+		void set_delta(std::string&& json, bool full)
+		{
+			frame_struct frame;
+			frame.set(std::make_shared<const std::string>(std::move(json)), WEBSOCKET_OP_TEXT);
+			frame.delta = !full;
+			_push(SEND_JSON, std::move(frame));
+		}
+
+		// Есть ли клиенты, получающие данные в формате CBOR.
+		bool is_cbor() const
+		{
+			return _server_data.binary_count > 0;
+		}
+
+		// Данные для клиентов с форматом CBOR (бинарные кадры).
+		void set_cbor(const uint8_t* data, size_t len)
+		{
+			frame_struct frame;
+			frame.set(std::make_shared<const std::string>(reinterpret_cast<const char*>(data), len), WEBSOCKET_OP_BINARY);
+			_push(SEND_CBOR, std::move(frame));
 		}
 	};
 }
\ No newline at end of file